@@ -0,0 +1,70 @@
+/// Regression check of the native delaunay engine (surfacemesh_filter_voromat/Delaunay3.h) on
+/// closed convex sample sets: n samples of the unit sphere, for a few seeds. Every sample left
+/// without a finite tetrahedron must be reported by nOrphans() (nativeVoronoiPoles then falls
+/// back to qhull instead of giving it the first pole), and the tetrahedra must be positively
+/// oriented with no other sample inside their circumsphere (checked on a subset).
+///
+///     delaunay_check [n] [seeds]      default 20000 samples, 3 seeds
+#include "Delaunay3.h"
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+static double ms(Clock::time_point a, Clock::time_point b){ return std::chrono::duration<double,std::milli>(b-a).count(); }
+
+static double det3(const double* a, const double* b, const double* c){
+    return a[0]*(b[1]*c[2]-b[2]*c[1]) - a[1]*(b[0]*c[2]-b[2]*c[0]) + a[2]*(b[0]*c[1]-b[1]*c[0]);
+}
+
+int main(int argc, char** argv){
+    int n = argc > 1 ? atoi(argv[1]) : 20000;
+    int nseeds = argc > 2 ? atoi(argv[2]) : 3;
+    int failures = 0;
+    for(int seed = 1; seed <= nseeds; seed++){
+        std::mt19937 rng(seed);
+        std::normal_distribution<double> gauss(0,1);
+        std::vector<double> xyz(3*n);
+        for(int i = 0; i < n; i++){
+            double* p = &xyz[3*i];
+            for(int k = 0; k < 3; k++) p[k] = gauss(rng);
+            double r = std::sqrt(p[0]*p[0] + p[1]*p[1] + p[2]*p[2]);
+            for(int k = 0; k < 3; k++) p[k] /= r;
+        }
+
+        Clock::time_point t0 = Clock::now();
+        Delaunay3 dt(&xyz[0], n, 1e-9, seed);
+        Clock::time_point t1 = Clock::now();
+
+        /// Samples without a finite tetrahedron, counted independently
+        std::vector<char> used(n, 0);
+        for(size_t k = 0; k < dt.tetra.size(); k++) used[dt.tetra[k]] = 1;
+        int orphans = std::count(used.begin(), used.end(), 0);
+
+        /// Orientation and empty circumsphere, on the first tetrahedra (slack for the joggle)
+        int bad = 0;
+        int nchecked = std::min(dt.nTetrahedra(), 200);
+        for(int t = 0; t < nchecked; t++){
+            const int* v = &dt.tetra[4*t];
+            double e[3][3];
+            for(int j = 0; j < 3; j++)
+                for(int k = 0; k < 3; k++) e[j][k] = xyz[3*v[j+1]+k] - xyz[3*v[0]+k];
+            bad += det3(e[0], e[1], e[2]) <= 0;
+            const double* c = &dt.center[3*t];
+            double r2 = 0;
+            for(int k = 0; k < 3; k++) r2 += (xyz[3*v[0]+k]-c[k])*(xyz[3*v[0]+k]-c[k]);
+            for(int i = 0; i < n; i++){
+                double d2 = 0;
+                for(int k = 0; k < 3; k++) d2 += (xyz[3*i+k]-c[k])*(xyz[3*i+k]-c[k]);
+                if(d2 < r2*(1-1e-6)){ bad++; break; }
+            }
+        }
+
+        bool ok = dt.nOrphans() == orphans && bad == 0;
+        failures += !ok;
+        printf("n=%d seed=%d  %d tetrahedra in %.0f ms, %d without tetrahedra (nOrphans %d), %d broken, %d bad of %d checked%s\n",
+               n, seed, dt.nTetrahedra(), ms(t0,t1), orphans, dt.nOrphans(), dt.nBroken(), bad, nchecked,
+               ok ? "" : "  FAILED");
+    }
+    return failures ? 2 : 0;
+}
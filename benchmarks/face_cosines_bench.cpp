@@ -0,0 +1,158 @@
+/// Per-face angle cache of TopologyJanitor (the splitter pass of mcfskel): the scalar path of the
+/// original cacheAngles (three edge lengths and three acos per face) against the blocked cosine
+/// kernel of cacheCosines (surfacemesh_filter_mcfskel/FaceCosines.h), on a triangle mesh stored
+/// as flat arrays (halfedge 3f+k is the one from corner k to corner k+1 of face f). Gather and
+/// scatter are timed with the kernels. Reports faces/sec and the largest difference between the
+/// angles of both paths.
+///
+///     face_cosines_bench [mesh.off|torus] [repeats]    default torus: 2M faces, 5 repeats
+#include "FaceCosines.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+
+typedef double Scalar;
+typedef std::chrono::steady_clock Clock;
+static double ms(Clock::time_point a, Clock::time_point b){ return std::chrono::duration<double,std::milli>(b-a).count(); }
+
+struct Point{
+    Scalar x[3];
+    Scalar operator[](int k) const { return x[k]; }
+};
+
+static Scalar distance(const Point& p, const Point& q){
+    return std::sqrt((p[0]-q[0])*(p[0]-q[0]) + (p[1]-q[1])*(p[1]-q[1]) + (p[2]-q[2])*(p[2]-q[2]));
+}
+
+static bool readOff(const char* path, std::vector<Point>& points, std::vector<int>& triangles){
+    std::ifstream in(path);
+    std::string header;
+    int nv, nf, ne;
+    if(!(in >> header >> nv >> nf >> ne) || header != "OFF") return false;
+    points.resize(nv);
+    for(int i = 0; i < nv; i++) in >> points[i].x[0] >> points[i].x[1] >> points[i].x[2];
+    triangles.resize(3*nf);
+    for(int f = 0; f < nf; f++){
+        int k;
+        in >> k >> triangles[3*f] >> triangles[3*f+1] >> triangles[3*f+2];
+        if(k != 3) return false;
+    }
+    return (bool)in;
+}
+
+/// Torus of major radius 1 and minor radius 0.3, U x V vertices, two triangles per quad
+static void makeTorus(int U, int V, std::vector<Point>& points, std::vector<int>& triangles){
+    const double pi = 3.14159265358979323846;
+    for(int i = 0; i < U; i++)
+        for(int j = 0; j < V; j++){
+            double u = 2*pi*i/U, v = 2*pi*j/V;
+            Point p = {{ (1+0.3*cos(v))*cos(u), (1+0.3*cos(v))*sin(u), 0.3*sin(v) }};
+            points.push_back(p);
+        }
+    for(int i = 0; i < U; i++)
+        for(int j = 0; j < V; j++){
+            int a = i*V+j, b = ((i+1)%U)*V+j, c = ((i+1)%U)*V+(j+1)%V, d = i*V+(j+1)%V;
+            int quad[6] = { a,b,c, a,c,d };
+            triangles.insert(triangles.end(), quad, quad+6);
+        }
+}
+
+/// Original cacheAngles: angle opposite to each halfedge, -1 for degenerate faces
+static void scalarAngles(const std::vector<Point>& points, const std::vector<int>& triangles, Scalar short_edge, std::vector<Scalar>& halpha){
+    int nf = triangles.size()/3;
+    for(int f = 0; f < nf; f++){
+        const Point& p0 = points[triangles[3*f]];
+        const Point& p1 = points[triangles[3*f+1]];
+        const Point& p2 = points[triangles[3*f+2]];
+        Scalar a = distance(p0,p1), a2 = a*a;
+        Scalar b = distance(p1,p2), b2 = b*b;
+        Scalar c = distance(p2,p0), c2 = c*c;
+        if(a<short_edge || b<short_edge || c<short_edge){
+            halpha[3*f] = halpha[3*f+1] = halpha[3*f+2] = -1;
+        } else {
+            halpha[3*f]   = std::acos(std::max(-1.0, std::min(1.0, (-a2 +b2 +c2)/(2*  b*c))));
+            halpha[3*f+1] = std::acos(std::max(-1.0, std::min(1.0, (+a2 -b2 +c2)/(2*a  *c))));
+            halpha[3*f+2] = std::acos(std::max(-1.0, std::min(1.0, (+a2 +b2 -c2)/(2*a*b  ))));
+        }
+    }
+}
+
+typedef FaceCosinesBlock<Scalar,int> CosinesBlock;
+
+static void flush(CosinesBlock& block, Scalar short_edge, std::vector<Scalar>& hcosalpha){
+    block.compute(short_edge);
+    for(int i = 0; i < block.n; i++)
+        for(int k = 0; k < 3; k++)
+            hcosalpha[3*block.handles[i]+k] = block.cosines(i,k);
+    block.n = 0;
+}
+
+/// cacheCosines: cosine of the angle opposite to each halfedge, 2 for degenerate faces
+static void blockedCosines(const std::vector<Point>& points, const std::vector<int>& triangles, Scalar short_edge, std::vector<Scalar>& hcosalpha){
+    int nf = triangles.size()/3;
+    CosinesBlock block;
+    for(int f = 0; f < nf; f++){
+        block.add(f, points[triangles[3*f]], points[triangles[3*f+1]], points[triangles[3*f+2]]);
+        if(block.full())
+            flush(block, short_edge, hcosalpha);
+    }
+    flush(block, short_edge, hcosalpha);
+}
+
+int main(int argc, char** argv){
+    const char* input = argc > 1 ? argv[1] : "torus";
+    int repeats = argc > 2 ? std::max(1, atoi(argv[2])) : 5;
+    std::vector<Point> points;
+    std::vector<int> triangles;
+    if(!strcmp(input, "torus"))
+        makeTorus(1000, 1000, points, triangles);
+    else if(!readOff(input, points, triangles)){
+        fprintf(stderr, "cannot read %s\n", input);
+        return 1;
+    }
+    int nf = triangles.size()/3;
+
+    /// Short edge threshold, a fraction of the bounding box diagonal: small, as the splitter runs
+    /// after the collapser removed the short edges, the faces are hardly ever degenerate
+    Point lo = points[0], hi = points[0];
+    for(size_t i = 0; i < points.size(); i++)
+        for(int k = 0; k < 3; k++){
+            lo.x[k] = std::min(lo.x[k], points[i][k]);
+            hi.x[k] = std::max(hi.x[k], points[i][k]);
+        }
+    Scalar short_edge = 1e-4*distance(lo, hi);
+
+    std::vector<Scalar> halpha(3*nf), hcosalpha(3*nf);
+    double tscalar = 1e30, tblocked = 1e30;
+    for(int r = 0; r < repeats; r++){
+        Clock::time_point t0 = Clock::now();
+        scalarAngles(points, triangles, short_edge, halpha);
+        Clock::time_point t1 = Clock::now();
+        blockedCosines(points, triangles, short_edge, hcosalpha);
+        Clock::time_point t2 = Clock::now();
+        tscalar = std::min(tscalar, ms(t0,t1));
+        tblocked = std::min(tblocked, ms(t1,t2));
+    }
+
+    /// Both paths must agree (angles and cosines, and on which faces are degenerate)
+    double maxdiff = 0;
+    int degenerate = 0, mismatches = 0;
+    for(int h = 0; h < 3*nf; h++){
+        bool d0 = halpha[h] < 0, d1 = hcosalpha[h] > 1;
+        if(d0 != d1){ mismatches++; continue; }
+        if(d0){ degenerate++; continue; }
+        maxdiff = std::max(maxdiff, std::fabs(std::acos(hcosalpha[h]) - halpha[h]));
+    }
+
+    printf("%d faces (%d degenerate), best of %d\n", nf, degenerate/3, repeats);
+    printf("  scalar acos    %8.1f ms  %6.1f Mfaces/s\n", tscalar, nf/tscalar/1e3);
+    printf("  blocked cosine %8.1f ms  %6.1f Mfaces/s\n", tblocked, nf/tblocked/1e3);
+    printf("  max angle difference %.3g, degenerate mismatches %d\n", maxdiff, mismatches);
+    return (mismatches || maxdiff > 1e-6) ? 2 : 0;
+}
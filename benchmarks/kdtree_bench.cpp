@@ -0,0 +1,104 @@
+/// Closest point queries of skeleton_compare: KDTree.h against FlatKDTree.h, one query at a time
+/// and batched (FlatKDTree::closest_points, OpenMP), on n points and m queries drawn either
+/// uniformly in the unit cube or along a helix (dense resampled skeleton), in random order or,
+/// for "sorted", in curve order as in a skeleton read from file. Checks that both trees and both
+/// query modes give the same answers, and the k-nn and ball queries of FlatKDTree against brute
+/// force on a few queries.
+///
+///     kdtree_bench n m [cube|helix|sorted]
+#include "KDTree.h"
+#include "FlatKDTree.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+static double ms(Clock::time_point a, Clock::time_point b){ return std::chrono::duration<double,std::milli>(b-a).count(); }
+
+int main(int argc, char** argv){
+    if(argc < 3){
+        fprintf(stderr, "usage: %s n m [cube|helix|sorted]\n", argv[0]);
+        return 1;
+    }
+    int n = atoi(argv[1]), m = atoi(argv[2]);
+    const char* mode = argc > 3 ? argv[3] : "cube";
+    bool sorted = !strcmp(mode, "sorted");
+    bool helix = sorted || !strcmp(mode, "helix");
+
+    std::mt19937 rng(1);
+    std::uniform_real_distribution<double> uniform(0,1);
+    std::normal_distribution<double> noise(0,0.002);
+    std::vector<double> xyz(3*n), q(3*m);
+    for(int i = 0; i < n; i++){
+        if(!helix){ for(int k = 0; k < 3; k++) xyz[3*i+k] = uniform(rng); continue; }
+        double t = sorted ? 20.0*i/n : 20*uniform(rng);
+        xyz[3*i] = cos(t)+noise(rng); xyz[3*i+1] = sin(t)+noise(rng); xyz[3*i+2] = t/20+noise(rng);
+    }
+    for(int i = 0; i < m; i++){
+        if(!helix){ for(int k = 0; k < 3; k++) q[3*i+k] = uniform(rng); continue; }
+        double t = sorted ? 20.0*i/m : 20*uniform(rng);
+        q[3*i] = cos(t)+5*noise(rng); q[3*i+1] = sin(t)+5*noise(rng); q[3*i+2] = t/20;
+    }
+
+    /// KDTree.h
+    Clock::time_point t0 = Clock::now();
+    std::vector<KDPoint> points(n);
+    for(int i = 0; i < n; i++) points[i] = KDPoint(&xyz[3*i], &xyz[3*i+3]);
+    KDTree kdtree(points);
+    Clock::time_point t1 = Clock::now();
+    std::vector<int> idx0(m);
+    std::vector<double> dist0(m);
+    for(int i = 0; i < m; i++)
+        kdtree.closest_point(KDPoint(&q[3*i], &q[3*i+3]), idx0[i], dist0[i]);
+    Clock::time_point t2 = Clock::now();
+
+    /// FlatKDTree.h, one by one then batched
+    FlatKDTree<3,double> flat(&xyz[0], n);
+    Clock::time_point t3 = Clock::now();
+    std::vector<int> idx1(m), idx2(m);
+    std::vector<double> dist1(m), dist2(m);
+    for(int i = 0; i < m; i++)
+        flat.closest_point(&q[3*i], idx1[i], dist1[i]);
+    Clock::time_point t4 = Clock::now();
+    flat.closest_points(&q[0], m, &idx2[0], &dist2[0]);
+    Clock::time_point t5 = Clock::now();
+
+    int mismatches = 0, batchmismatches = 0;
+    for(int i = 0; i < m; i++){
+        mismatches += (idx0[i] != idx1[i]) || (dist0[i] != dist1[i]);
+        batchmismatches += (idx1[i] != idx2[i]) || (dist1[i] != dist2[i]);
+    }
+
+    /// k-nn and ball queries against brute force
+    int wrong = 0;
+    const int K = 7;
+    for(int i = 0; i < std::min(m,200); i++){
+        std::vector< std::pair<double,int> > all;
+        for(int j = 0; j < n; j++){
+            double d = 0;
+            for(int k = 0; k < 3; k++) d += (q[3*i+k]-xyz[3*j+k])*(q[3*i+k]-xyz[3*j+k]);
+            all.push_back(std::make_pair(sqrt(d), j));
+        }
+        std::sort(all.begin(), all.end());
+        std::vector<int> knn;
+        std::vector<double> knnd;
+        flat.k_closest_points(&q[3*i], K, knn, knnd);
+        for(int j = 0; j < std::min(K,n); j++) wrong += fabs(all[j].first - knnd[j]) > 1e-15;
+        if(n < 22) continue;
+        double radius = 0.5*(all[20].first + all[21].first);  ///< between two neighbors
+        std::vector<int> ball;
+        std::vector<double> balld;
+        flat.ball_query(&q[3*i], radius, ball, balld);
+        wrong += ball.size() != 21;
+    }
+
+    printf("n=%d m=%d %s\n", n, m, mode);
+    printf("  KDTree      build %8.1f ms  query %8.1f ms\n", ms(t0,t1), ms(t1,t2));
+    printf("  FlatKDTree  build %8.1f ms  query %8.1f ms  batched %8.1f ms\n", ms(t2,t3), ms(t3,t4), ms(t4,t5));
+    printf("  mismatches: KDTree/FlatKDTree %d, one by one/batched %d, k-nn/ball vs brute force %d\n",
+           mismatches, batchmismatches, wrong);
+    return (mismatches || batchmismatches || wrong) ? 2 : 0;
+}
@@ -0,0 +1,18 @@
+#pragma once
+/// Stand-in for curveskel/CurveskelHelper.h (which pulls in Qt): just the types used by
+/// surfacemesh_filter_to_skeleton/MyPriorityQueue.h, and a qDebug() that drops everything.
+#include "WingedgeMesh.h"
+#include "Vector.h"
+
+struct NullDebug{
+    template <class T> NullDebug& operator<<(const T&){ return *this; }
+};
+inline NullDebug qDebug(){ return NullDebug(); }
+
+namespace CurveskelTypes{
+    typedef double Scalar;
+    typedef SkelVector<double,3> Vector3;
+    typedef WingedgeMesh<Scalar,Vector3> CurveskelModel;
+    typedef CurveskelModel::Vertex Vertex;
+    typedef CurveskelModel::Edge Edge;
+}
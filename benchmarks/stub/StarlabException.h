@@ -0,0 +1,8 @@
+#pragma once
+#include <stdexcept>
+
+/// Stand-in for the Starlab exception, the drivers are built without Starlab
+class StarlabException : public std::runtime_error{
+public:
+    StarlabException(const char* message) : std::runtime_error(message){}
+};
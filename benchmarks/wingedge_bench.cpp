@@ -0,0 +1,163 @@
+/// Collapse loop of surfacemesh_filter_to_skeleton on a WingedgeMesh, without Starlab/Qt:
+/// builds the mesh from a triangle mesh, collapses the shortest edges until no face is left
+/// (same queue and update as ToSkeletonHelper::convert), then collects the garbage.
+///
+/// Prints the timings of the three phases, the memory, and checksums of the skeleton (nodes and
+/// edges before, connectivity and positions after the collection) to compare two versions of
+/// WingedgeMesh.h. See README.md for the build and the versions.
+///
+///     wingedge_bench mesh.off     triangle mesh (OFF)
+///     wingedge_bench torus        250k vertices / 500k faces torus, generated
+#include "MyPriorityQueue.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <sys/resource.h>
+using namespace CurveskelTypes;
+
+/// Peak resident set size in KB (as peakmemory() in surfacemesh_filter_mcfskel/Logfile.cpp)
+static long peakmemory(){
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+    return usage.ru_maxrss/1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+typedef std::chrono::steady_clock Clock;
+static double ms(Clock::time_point a, Clock::time_point b){ return std::chrono::duration<double,std::milli>(b-a).count(); }
+
+static bool readOff(const char* path, std::vector<double>& xyz, std::vector<int>& triangles){
+    std::ifstream in(path);
+    std::string header;
+    int nv, nf, ne;
+    if(!(in >> header >> nv >> nf >> ne) || header != "OFF") return false;
+    xyz.resize(3*nv);
+    for(int i = 0; i < 3*nv; i++) in >> xyz[i];
+    triangles.resize(3*nf);
+    for(int f = 0; f < nf; f++){
+        int k;
+        in >> k >> triangles[3*f] >> triangles[3*f+1] >> triangles[3*f+2];
+        if(k != 3) return false;
+    }
+    return (bool)in;
+}
+
+/// Torus of major radius 1 and minor radius 0.3, U x V vertices, two triangles per quad
+static void makeTorus(int U, int V, std::vector<double>& xyz, std::vector<int>& triangles){
+    const double pi = 3.14159265358979323846;
+    for(int i = 0; i < U; i++)
+        for(int j = 0; j < V; j++){
+            double u = 2*pi*i/U, v = 2*pi*j/V;
+            xyz.push_back((1+0.3*cos(v))*cos(u));
+            xyz.push_back((1+0.3*cos(v))*sin(u));
+            xyz.push_back(0.3*sin(v));
+        }
+    for(int i = 0; i < U; i++)
+        for(int j = 0; j < V; j++){
+            int a = i*V+j, b = ((i+1)%U)*V+j, c = ((i+1)%U)*V+(j+1)%V, d = i*V+(j+1)%V;
+            int quad[6] = { a,b,c, a,c,d };
+            triangles.insert(triangles.end(), quad, quad+6);
+        }
+}
+
+int main(int argc, char** argv){
+    if(argc < 2){
+        fprintf(stderr, "usage: %s mesh.off|torus\n", argv[0]);
+        return 1;
+    }
+    std::vector<double> xyz;
+    std::vector<int> triangles;
+    if(!strcmp(argv[1], "torus"))
+        makeTorus(1000, 250, xyz, triangles);
+    else if(!readOff(argv[1], xyz, triangles)){
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 1;
+    }
+    int nv = xyz.size()/3, nf = triangles.size()/3;
+
+    /// 1) Build
+    long mem0 = peakmemory();
+    Clock::time_point t0 = Clock::now();
+    CurveskelModel* skel = new CurveskelModel();
+    for(int i = 0; i < nv; i++)
+        skel->add_vertex(Vector3(xyz[3*i], xyz[3*i+1], xyz[3*i+2]));
+#ifdef LEGACY_WINGEDGE
+    for(int f = 0; f < nf; f++){
+        std::vector<Vertex> face;
+        for(int k = 0; k < 3; k++) face.push_back(Vertex(triangles[3*f+k]));
+        skel->add_face(face);
+    }
+#else
+    skel->use_edge_index();
+    skel->add_triangles(triangles);
+#endif
+    Clock::time_point t1 = Clock::now();
+    long mem1 = peakmemory();
+
+    /// 2) Collapse, shortest edge first
+    MyPriorityQueue queue(skel);
+    for(int e = 0; e < (int)skel->edges_size(); e++)
+        queue.insert(Edge(e), skel->edge_length(Edge(e)));
+    int ncollapses = 0;
+    while(!queue.empty()){
+        Edge e = queue.pop();
+        if(!skel->has_faces(e) || skel->is_deleted(e) || !skel->is_valid(e)) continue;
+        Vertex v2 = skel->vertex(e, 1);
+        skel->collapse(e);
+        CurveskelModel::Edge_around_vertex eit(skel, v2);
+        while(!eit.end()){
+            Edge edge = eit;
+            if(queue.has(edge)) queue.update(edge, skel->edge_length(edge));
+            ++eit;
+        }
+        ncollapses++;
+    }
+    Clock::time_point t2 = Clock::now();
+
+    unsigned long vsum = 0, esum = 0;
+    int nnodes = 0, nedges = 0;
+    for(int v = 0; v < (int)skel->vertices_size(); v++)
+        if(!skel->is_deleted(Vertex(v))){ vsum = vsum*31 + v; nnodes++; }
+    for(int e = 0; e < (int)skel->edges_size(); e++){
+        Edge edge(e);
+        if(skel->is_deleted(edge) || skel->is_deleted(skel->vertex(edge,0)) || skel->is_deleted(skel->vertex(edge,1))) continue;
+        esum = esum*31 + e*7 + skel->vertex(edge,0).idx();
+        nedges++;
+    }
+
+    /// 3) Garbage collection, with a custom property (kept since the in-place collection)
+    CurveskelModel::Vertex_property<int> tag = skel->vertex_property<int>("v:tag", -1);
+    for(int v = 0; v < (int)skel->vertices_size(); v++) tag[Vertex(v)] = v;
+    skel->garbage_collection();
+    Clock::time_point t3 = Clock::now();
+
+    unsigned long gcsum = 0;
+    for(int e = 0; e < (int)skel->edges_size(); e++)
+        gcsum = gcsum*1000003 + skel->vertex(Edge(e),0).idx()*7 + skel->vertex(Edge(e),1).idx();
+    double psum = 0;
+    CurveskelModel::Vertex_property<Vector3> points = skel->vertex_property<Vector3>("v:point");
+    for(int v = 0; v < (int)skel->vertices_size(); v++) psum += (v+1)*points[Vertex(v)][0];
+    int ntagged = 0;
+    tag = skel->get_vertex_property<int>("v:tag");
+    if(tag)
+        for(int v = 0; v < (int)skel->vertices_size(); v++) ntagged += (tag[Vertex(v)] >= 0);
+
+    printf("%d vertices, %d faces\n", nv, nf);
+    printf("  build    %8.0f ms\n", ms(t0,t1));
+    printf("  collapse %8.0f ms (%d collapses)\n", ms(t1,t2), ncollapses);
+    printf("  gc       %8.0f ms\n", ms(t2,t3));
+    printf("  memory   +%ld MB after build, peak %ld MB\n", (mem1-mem0)/1024, peakmemory()/1024);
+    printf("  skeleton %d nodes, %d edges\n", nnodes, nedges);
+    printf("  after gc %d nodes, %d edges, %d faces, %d nodes tagged\n",
+           skel->n_vertices(), skel->n_edges(), skel->n_faces(), ntagged);
+    printf("  checksums: nodes %lu edges %lu, after gc: edges %lu points %.12g\n", vsum, esum, gcsum, psum);
+    delete skel;
+    return 0;
+}
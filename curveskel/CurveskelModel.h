@@ -1,5 +1,6 @@
 #pragma once
 
+#include <vector>
 #include <QDebug>
 #include <QString>
 
@@ -33,5 +34,13 @@ namespace CurveskelTypes
 
 		std::set<Vertex> adjacent_set(Vertex v);
 		Vertex other_vertex(Edge e, Vertex v);
+
+        /// @{ Vertices of the original surface each node stands for, when known (filled by the
+        ///    conversion from a surface). Those of node v are samples[samples_offset[v]...
+        ///    samples_offset[v+1]-1]; only meaningful while the nodes are not edited.
+        std::vector<int> samples_offset;
+        std::vector<int> samples;
+        bool has_samples(){ return samples_offset.size()==n_vertices()+1; }
+        /// @}
     };
 }
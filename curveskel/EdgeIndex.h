@@ -0,0 +1,108 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+
+namespace CurveskelTypes{
+
+/// Map from an unordered pair of vertex indexes to the index of the edge joining them, used by
+/// WingedgeMesh to find an existing edge in O(1) rather than by scanning the edges of a vertex.
+/// Open addressing with linear probing in a power of two table kept at most half full; erasing
+/// shifts the following entries back, so there are no tombstones.
+class EdgeIndex{
+private:
+    typedef unsigned long long Key;
+    struct Slot{
+        Key key;
+        int edge;   ///< -1 if the slot is empty
+    };
+    std::vector<Slot> table;
+    int count;
+
+    static Key key(int a, int b){
+        if(b < a) std::swap(a,b);
+        return ((Key)(unsigned int)a << 32) | (Key)(unsigned int)b;
+    }
+    size_t home(Key k) const {
+        return (size_t)((k * 0x9E3779B97F4A7C15ULL) >> 32) & (table.size()-1);
+    }
+    size_t next(size_t i) const { return (i+1) & (table.size()-1); }
+
+    void rehash(size_t capacity){
+        std::vector<Slot> old;
+        old.swap(table);
+        Slot empty = {0,-1};
+        table.assign(capacity, empty);
+        for(size_t i=0; i<old.size(); i++){
+            if(old[i].edge < 0) continue;
+            size_t j = home(old[i].key);
+            while(table[j].edge >= 0) j = next(j);
+            table[j] = old[i];
+        }
+    }
+
+public:
+    EdgeIndex() : count(0){}
+
+    int size() const { return count; }
+
+    void clear(){
+        table.clear();
+        count = 0;
+    }
+
+    /// Makes room for n edges without rehashing
+    void reserve(int n){
+        size_t capacity = 16;
+        while(capacity < 2*(size_t)n) capacity *= 2;
+        if(capacity > table.size()) rehash(capacity);
+    }
+
+    /// Edge joining a and b, -1 if none
+    int find(int a, int b) const {
+        if(table.empty()) return -1;
+        Key k = key(a,b);
+        for(size_t i = home(k); table[i].edge >= 0; i = next(i))
+            if(table[i].key == k) return table[i].edge;
+        return -1;
+    }
+
+    /// Sets the edge joining a and b (replaces the previous one, if any)
+    void insert(int a, int b, int edge){
+        if(2*(size_t)(count+1) > table.size()) rehash(std::max<size_t>(16, 2*table.size()));
+        Key k = key(a,b);
+        size_t i = home(k);
+        for(; table[i].edge >= 0; i = next(i))
+            if(table[i].key == k){ table[i].edge = edge; return; }
+        table[i].key = k;
+        table[i].edge = edge;
+        count++;
+    }
+
+    /// Removes the pair a,b if it is mapped to edge
+    void erase(int a, int b, int edge){
+        if(table.empty()) return;
+        Key k = key(a,b);
+        size_t i = home(k);
+        for(; table[i].edge >= 0; i = next(i))
+            if(table[i].key == k) break;
+        if(table[i].edge != edge) return;
+
+        /// Move back the entries of the cluster which would not be found anymore
+        size_t j = i;
+        for(;;){
+            table[i].edge = -1;
+            for(;;){
+                j = next(j);
+                if(table[j].edge < 0){ count--; return; }
+                size_t h = home(table[j].key);
+                /// can the entry at j stay, i.e. is its home cyclically in (i,j]?
+                if(i <= j ? (i < h && h <= j) : (i < h || h <= j)) continue;
+                break;
+            }
+            table[i] = table[j];
+            i = j;
+        }
+    }
+};
+
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <algorithm>
+#include <utility>
+#include <cstddef>
+
+namespace CurveskelTypes{
+
+/// Sorted set of (small, trivially copyable) handles with room for N of them inline, spilling to
+/// the heap only when it grows larger. It replaces std::set in the connectivity of WingedgeMesh:
+/// skeleton vertices have 1-4 edges, triangles 3 vertices and manifold edges 2 faces, so most
+/// elements never allocate, and iteration order is the same as the one of std::set (increasing).
+/// Iterators are plain pointers, invalidated by insert/erase.
+template <class T, int N>
+class SmallSet{
+public:
+    typedef T value_type;
+    typedef T* iterator;
+    typedef const T* const_iterator;
+
+private:
+    T* data_;          ///< inline_ or a heap block of capacity_ elements
+    int size_;
+    int capacity_;
+    T inline_[N];
+
+    void grow(){
+        int capacity = 2*capacity_;
+        T* data = new T[capacity];
+        std::copy(data_, data_+size_, data);
+        if(data_ != inline_) delete[] data_;
+        data_ = data;
+        capacity_ = capacity;
+    }
+
+public:
+    SmallSet() : data_(inline_), size_(0), capacity_(N){}
+    SmallSet(const SmallSet& rhs) : data_(inline_), size_(0), capacity_(N){ *this = rhs; }
+    ~SmallSet(){ if(data_ != inline_) delete[] data_; }
+
+    SmallSet& operator=(const SmallSet& rhs){
+        if(this == &rhs) return *this;
+        size_ = 0;
+        while(capacity_ < rhs.size_) grow();
+        std::copy(rhs.begin(), rhs.end(), data_);
+        size_ = rhs.size_;
+        return *this;
+    }
+
+    iterator begin(){ return data_; }
+    iterator end(){ return data_+size_; }
+    const_iterator begin() const { return data_; }
+    const_iterator end() const { return data_+size_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    void clear(){ size_ = 0; }
+
+    iterator find(const T& x){
+        iterator it = std::lower_bound(begin(), end(), x);
+        return (it != end() && !(x < *it)) ? it : end();
+    }
+    const_iterator find(const T& x) const{
+        const_iterator it = std::lower_bound(begin(), end(), x);
+        return (it != end() && !(x < *it)) ? it : end();
+    }
+
+    std::pair<iterator,bool> insert(const T& x){
+        int i = std::lower_bound(begin(), end(), x) - begin();
+        if(i < size_ && !(x < data_[i])) return std::make_pair(data_+i, false);
+        if(size_ == capacity_) grow();
+        std::copy_backward(data_+i, data_+size_, data_+size_+1);
+        data_[i] = x;
+        size_++;
+        return std::make_pair(data_+i, true);
+    }
+
+    /// Removes [first,last), the following elements move back
+    iterator erase(iterator first, iterator last){
+        std::copy(last, end(), first);
+        size_ -= last - first;
+        return first;
+    }
+
+    size_t erase(const T& x){
+        iterator it = find(x);
+        if(it == end()) return 0;
+        std::copy(it+1, end(), it);
+        size_--;
+        return 1;
+    }
+};
+
+}
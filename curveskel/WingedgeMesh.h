@@ -2,10 +2,13 @@
 #include <exception>
 #include <cassert>
 #include <vector>
+#include <algorithm>
 #include <set>
 #include <map>
 #include <iostream>
 #include "StarlabException.h"
+#include "SmallSet.h"
+#include "EdgeIndex.h"
 
 namespace CurveskelTypes{
 
@@ -456,16 +459,21 @@ public: //------------------------------------------------------ topology types
 
 public: //-------------------------------------------------- connectivity types
 
+    /// Adjacency lists, sorted, stored inline up to the typical size (see SmallSet)
+    typedef SmallSet<Edge,6>   Edge_set;
+    typedef SmallSet<Vertex,3> Vertex_set;
+    typedef SmallSet<Face,2>   Face_set;
+
     /// This type stores the vertex connectivity
     struct Vertex_connectivity
     {
-        std::set<Edge> edges_;
+        Edge_set edges_;
     };
 
     /// This type stores the face connectivity
     struct Face_connectivity
     {
-        std::set<Vertex> vertices_;
+        Vertex_set vertices_;
     };
 
     /// This type stores the edge connectivity
@@ -476,7 +484,7 @@ public: //-------------------------------------------------- connectivity types
         Vertex    vertex1_;
         
         /// wing faces
-        std::set<Face> faces_;
+        Face_set faces_;
     };
 
 public: //------------------------------------------------------ property types
@@ -719,10 +727,12 @@ public: //---------------------------------------------------- circulator types
 	public:
 
 		/// default constructor
-		Edge_around_vertex(const WingedgeMesh* m=NULL, Vertex v=Vertex()): mesh_(m)
+		Edge_around_vertex(const WingedgeMesh* m=NULL, Vertex v=Vertex()): mesh_(m), edge_(NULL), end_(NULL)
 		{
-			edge_ = mesh_->vconn_[v].edges_.begin();
-			end_ = mesh_->vconn_[v].edges_.end();
+			if(mesh_ && mesh_->is_valid(v)){
+				edge_ = mesh_->vconn_[v].edges_.begin();
+				end_ = mesh_->vconn_[v].edges_.end();
+			}
 		}
 
 		bool end()
@@ -760,13 +770,13 @@ public: //---------------------------------------------------- circulator types
 		operator Edge() const { return *edge_; }
 
 		/// cast to bool: true if vertex is not isolated
-		operator bool() const { return mesh_->is_valid(*edge_); }
+		operator bool() const { return (edge_ != end_) && mesh_->is_valid(*edge_); }
 
-		operator typename std::set<Edge>::iterator() const { return edge_; }
+		operator typename Edge_set::const_iterator() const { return edge_; }
 
 	private:
 		const WingedgeMesh*  mesh_;
-		typename std::set<Edge>::iterator edge_, end_;
+		typename Edge_set::const_iterator edge_, end_;
 	};
 
 public: //-------------------------------------------- constructor / destructor
@@ -788,6 +798,7 @@ public: //-------------------------------------------- constructor / destructor
 
         deleted_vertices_ = deleted_edges_ = deleted_faces_ = 0;
         garbage_ = false;
+        use_edge_index_ = false;
     }
 
     // destructor
@@ -878,6 +889,78 @@ public: //----------------------------------------------- add new vertex / face
         return f;
     }
 
+    /// add the triangles (v0,v1,v2) stored consecutively in \c triangles, all at once: the
+    /// sides are sorted by their vertex pair (counting sort on the smaller vertex), so shared
+    /// edges are found by a single pass rather than by a lookup per side. Edges are numbered and
+    /// oriented as by add_face() on each triangle in sequence.
+    /// \sa add_face
+    void add_triangles(const std::vector<int>& triangles)
+    {
+        int nsides = triangles.size() - triangles.size() % 3;
+        int nverts = vertices_size();
+        bool hadedges = (edges_size() > 0);
+
+        // Side s goes from triangles[s] to other[s]
+        std::vector<int> other(nsides), lo(nsides), hi(nsides);
+        for(int s = 0; s < nsides; s++){
+            other[s] = triangles[(s % 3 == 2) ? s-2 : s+1];
+            assert(triangles[s] != other[s]);
+            lo[s] = std::min(triangles[s], other[s]);
+            hi[s] = std::max(triangles[s], other[s]);
+        }
+
+        // Sides by smaller vertex, then by larger vertex and position
+        std::vector<int> offset(nverts+1, 0), sorted(nsides);
+        for(int s = 0; s < nsides; s++) offset[lo[s]+1]++;
+        for(int v = 0; v < nverts; v++) offset[v+1] += offset[v];
+        {
+            std::vector<int> next(offset.begin(), offset.end()-1);
+            for(int s = 0; s < nsides; s++) sorted[ next[lo[s]]++ ] = s;
+        }
+        std::vector< std::pair<int,int> > bucket;
+        for(int v = 0; v < nverts; v++){
+            int begin = offset[v], end = offset[v+1];
+            if(end - begin < 2) continue;
+            bucket.clear();
+            for(int k = begin; k < end; k++) bucket.push_back(std::make_pair(hi[sorted[k]], sorted[k]));
+            std::sort(bucket.begin(), bucket.end());
+            for(int k = begin; k < end; k++) sorted[k] = bucket[k-begin].second;
+        }
+
+        // Each side points to the first side of its group, the one add_face creates the edge for
+        std::vector<int> first(nsides);
+        int nedges = 0;
+        for(int k = 0; k < nsides; k++){
+            int s = sorted[k];
+            bool same = (k > 0) && (lo[sorted[k-1]] == lo[s]) && (hi[sorted[k-1]] == hi[s]);
+            first[s] = same ? first[sorted[k-1]] : s;
+            if(!same) nedges++;
+        }
+
+        // Edges in order of first appearance (or the existing one)
+        eprops_.reserve(edges_size() + nedges);
+        if(use_edge_index_) edge_index_.reserve(n_edges() + nedges);
+        std::vector<Edge> edgeof(nsides);
+        for(int s = 0; s < nsides; s++){
+            if(first[s] != s){
+                edgeof[s] = edgeof[first[s]];
+                continue;
+            }
+            Vertex start(triangles[s]), end(other[s]);
+            Edge e = hadedges ? get_edge(start, end) : Edge();
+            edgeof[s] = (e.idx() >= 0) ? e : create_edge(start, end);
+        }
+
+        fprops_.reserve(faces_size() + nsides/3);
+        for(int t = 0; t < nsides; t += 3){
+            Face f(new_face());
+            for(int i = 0; i < 3; i++){
+                set_vertex(f, Vertex(triangles[t+i]));
+                set_face(edgeof[t+i], f);
+            }
+        }
+    }
+
     //@}
 
 
@@ -918,6 +1001,7 @@ public: //--------------------------------------------------- memory management
         eprops_.free_memory();
         fprops_.free_memory();
     
+        edge_index_.clear();
         deleted_vertices_ = deleted_edges_ = deleted_faces_ = 0;
         garbage_ = false;
     }
@@ -934,51 +1018,91 @@ public: //--------------------------------------------------- memory management
         vprops_.reserve(nvertices);
         eprops_.reserve(nedges);
         fprops_.reserve(nfaces);
+        if(use_edge_index_) edge_index_.reserve(nedges);
     }
 
-    /// remove deleted vertices/edges/[faces: not implemented]
-    void garbage_collection()
-	{
-        std::map<int, int> points;
-        std::vector< Vector > points_pos;
-        std::vector< std::pair<int,int> > edges;
-
-        int vidx = 0;
-
-        // Collect living vertices
-        for(Vertex_iterator vi = vertices_begin(); vi != vertices_end(); ++vi )
-        {
-            Vertex v = vi;
-            if(is_deleted(v) || !is_valid(v)) continue;
-
-            points[v.idx()] = vidx++;
-            points_pos.push_back(vpoint_[v]);
+    /// keep a (vertex,vertex)=>edge hash of the live edges, so that get_edge(), thus add_edge(),
+    /// add_face() and the removal of duplicate edges in collapse(), take O(1) per edge rather
+    /// than a scan of the edges of a vertex. The index is built from the current edges.
+    void use_edge_index(bool enable = true)
+    {
+        use_edge_index_ = enable;
+        edge_index_.clear();
+        if(!enable) return;
+        edge_index_.reserve(n_edges());
+        for(int i = 0; i < (int) edges_size(); i++){
+            Edge e(i);
+            if(!is_deleted(e)) edge_index_.insert(vertex(e,0).idx(), vertex(e,1).idx(), i);
         }
+    }
 
-        // Collect living edges
-        for(Edge_iterator ei = edges_begin(); ei != edges_end(); ++ei)
-        {
-            Edge e = ei;
-
-            Vertex v0 = vertex(e,0);
-            Vertex v1 = vertex(e,1);
+    /// is the (vertex,vertex)=>edge hash maintained?
+    bool has_edge_index() const { return use_edge_index_; }
 
-            if(!is_deleted(e) && !is_deleted(v0) && !is_deleted(v1) && v0 != v1)
-                edges.push_back(std::pair<int,int> (points[v0.idx()], points[v1.idx()]) );
+    /// remove deleted vertices, edges and faces, as well as the edges and faces left with a
+    /// deleted vertex and the edges collapsed to a point. Live elements keep their relative
+    /// order and are moved forward in place, in every property array (custom ones included),
+    /// and the connectivity is remapped; a single pass over each kind of element.
+    void garbage_collection()
+    {
+        int nv = vertices_size(), ne = edges_size(), nf = faces_size();
+
+        // New index of every element, -1 if it goes away
+        std::vector<int> vmap(nv, -1), emap(ne, -1), fmap(nf, -1);
+        int nvlive = 0, nelive = 0, nflive = 0;
+        for(int i = 0; i < nv; i++)
+            if(!vdeleted_[Vertex(i)]) vmap[i] = nvlive++;
+        for(int i = 0; i < ne; i++){
+            Vertex v0 = econn_[Edge(i)].vertex0_, v1 = econn_[Edge(i)].vertex1_;
+            if(!edeleted_[Edge(i)] && vmap[v0.idx()] >= 0 && vmap[v1.idx()] >= 0 && v0 != v1)
+                emap[i] = nelive++;
+        }
+        for(int i = 0; i < nf; i++){
+            bool live = !fdeleted_[Face(i)];
+            Vertex_set& vertices = fconn_[Face(i)].vertices_;
+            for(typename Vertex_set::iterator vit = vertices.begin(); live && vit != vertices.end(); vit++)
+                live = (vmap[vit->idx()] >= 0);
+            if(live) fmap[i] = nflive++;
         }
 
-        // Remove old records
-        clear();
+        // Connectivity in the new indices (maps are increasing, lists stay sorted)
+        for(int i = 0; i < nv; i++){
+            if(vmap[i] < 0) continue;
+            Edge_set& edges = vconn_[Vertex(i)].edges_;
+            typename Edge_set::iterator out = edges.begin();
+            for(typename Edge_set::iterator eit = edges.begin(); eit != edges.end(); eit++)
+                if(emap[eit->idx()] >= 0) *out++ = Edge(emap[eit->idx()]);
+            edges.erase(out, edges.end());
+        }
+        for(int i = 0; i < ne; i++){
+            if(emap[i] < 0) continue;
+            Edge_connectivity& conn = econn_[Edge(i)];
+            conn.vertex0_ = Vertex(vmap[conn.vertex0_.idx()]);
+            conn.vertex1_ = Vertex(vmap[conn.vertex1_.idx()]);
+            typename Face_set::iterator out = conn.faces_.begin();
+            for(typename Face_set::iterator fit = conn.faces_.begin(); fit != conn.faces_.end(); fit++)
+                if(fmap[fit->idx()] >= 0) *out++ = Face(fmap[fit->idx()]);
+            conn.faces_.erase(out, conn.faces_.end());
+        }
+        for(int i = 0; i < nf; i++){
+            if(fmap[i] < 0) continue;
+            Vertex_set& vertices = fconn_[Face(i)].vertices_;
+            for(typename Vertex_set::iterator vit = vertices.begin(); vit != vertices.end(); vit++)
+                *vit = Vertex(vmap[vit->idx()]);
+        }
 
-        // Add clean structure:
+        // Move the live elements forward, in all the property arrays
+        for(int i = 0; i < nv; i++) if(vmap[i] >= 0 && vmap[i] != i) vprops_.swap(i, vmap[i]);
+        for(int i = 0; i < ne; i++) if(emap[i] >= 0 && emap[i] != i) eprops_.swap(i, emap[i]);
+        for(int i = 0; i < nf; i++) if(fmap[i] >= 0 && fmap[i] != i) fprops_.swap(i, fmap[i]);
+        vprops_.resize(nvlive);
+        eprops_.resize(nelive);
+        fprops_.resize(nflive);
 
-		// Vertices
-        for(unsigned int i = 0; i < points_pos.size(); i++)
-            this->add_vertex(points_pos[i]);
+        deleted_vertices_ = deleted_edges_ = deleted_faces_ = 0;
+        garbage_ = false;
 
-		// Edges
-        for(unsigned int i = 0; i < edges.size(); i++)
-            this->add_edge(Vertex(edges[i].first), Vertex(edges[i].second));
+        if(use_edge_index_) use_edge_index(true);
     }
 
 
@@ -1054,7 +1178,7 @@ public: //---------------------------------------------- low-level connectivity
 	bool has_faces(Edge e)
 	{
 		// Check if any faces are not deleted
-		for(typename std::set<Face>::iterator fit = econn_[e].faces_.begin(); fit != econn_[e].faces_.end(); fit++)
+		for(typename Face_set::iterator fit = econn_[e].faces_.begin(); fit != econn_[e].faces_.end(); fit++)
 		{
 			if(!fdeleted_[*fit])
 				return true;
@@ -1321,7 +1445,7 @@ public: //------------------------------------------ geometry-related functions
 	{
 		printf("Vertex (%d) has edges: {", v.idx());
 
-		for(typename std::set<Edge>::iterator eit = vconn_[v].edges_.begin(); eit != vconn_[v].edges_.end(); eit++){
+		for(typename Edge_set::iterator eit = vconn_[v].edges_.begin(); eit != vconn_[v].edges_.end(); eit++){
 			printf("%d, ", eit->idx());
 		}
 
@@ -1332,7 +1456,7 @@ public: //------------------------------------------ geometry-related functions
 	{
 		printf("Vertex (%d) has edges: {{{{", v.idx());
 
-		for(typename std::set<Edge>::iterator eit = vconn_[v].edges_.begin(); eit != vconn_[v].edges_.end(); eit++)
+		for(typename Edge_set::iterator eit = vconn_[v].edges_.begin(); eit != vconn_[v].edges_.end(); eit++)
 		{
 			printf("\t");
 			print_faces(*eit);
@@ -1350,7 +1474,7 @@ public: //------------------------------------------ geometry-related functions
 	{
 		printf("Edge (%d) has faces: {", e.idx());
 
-		for(typename std::set<Face>::iterator fit = econn_[e].faces_.begin(); fit != econn_[e].faces_.end(); fit++)
+		for(typename Face_set::iterator fit = econn_[e].faces_.begin(); fit != econn_[e].faces_.end(); fit++)
 		{
 			printf("%d, ", fit->idx());
 		}
@@ -1382,6 +1506,11 @@ protected: //---------------------------------------------- allocate new element
         Edge pastEdge = get_edge(start, end);
         if(pastEdge.idx() >= 0) return pastEdge;
 
+        return create_edge(start, end);
+    }
+
+    /// allocate an edge known not to exist yet
+    Edge create_edge(Vertex start, Vertex end){
         eprops_.push_back();
         Edge e(edges_size()-1);
         econn_[e].vertex0_ = start;
@@ -1391,6 +1520,8 @@ protected: //---------------------------------------------- allocate new element
         set_edge(start, e);
         set_edge(end, e);
 
+        if(use_edge_index_) edge_index_.insert(start.idx(), end.idx(), e.idx());
+
         return e;
     }
 
@@ -1414,8 +1545,15 @@ public: //--------------------------------------------------- helper functions
 		remove_edge(v1, e);
 		remove_edge(v2, e);
 
+		if(use_edge_index_){
+			edge_index_.erase(v1.idx(), v2.idx(), e.idx());
+			merge_edges(v1, v2, econn_[e].faces_);
+			delete_collapsed(v1, econn_[e].faces_);
+			return;
+		}
+
 		// Replace 'v1' in edges of 'v1' -> 'v2'
-		for(typename std::set<Edge>::iterator eit = vconn_[v1].edges_.begin(); eit != vconn_[v1].edges_.end(); eit++){
+		for(typename Edge_set::iterator eit = vconn_[v1].edges_.begin(); eit != vconn_[v1].edges_.end(); eit++){
 			replace_vertex(*eit, v1, v2);
 
 			// connect to new vertex
@@ -1423,7 +1561,7 @@ public: //--------------------------------------------------- helper functions
 		}
 
 		// Delete dead faces of removed edge 'e'
-		std::set<Face> deadFaces = econn_[e].faces_;
+		Face_set deadFaces = econn_[e].faces_;
 
 		// Remove the duplicated edges
 		std::vector<Edge> v2_adj = edges_of(v2);
@@ -1440,9 +1578,9 @@ public: //--------------------------------------------------- helper functions
 				if( same_edge(ei, ej) )
 				{
 					// Migrate faces of 'ei'
-					std::set<Face> oldFaces = econn_[ei].faces_;
+					Face_set oldFaces = econn_[ei].faces_;
 
-					for(typename std::set<Face>::iterator fit = oldFaces.begin(); fit != oldFaces.end(); fit++)
+					for(typename Face_set::iterator fit = oldFaces.begin(); fit != oldFaces.end(); fit++)
 					{
 						if(deadFaces.find(*fit) == deadFaces.end())
 							set_face(ej, *fit);
@@ -1456,6 +1594,51 @@ public: //--------------------------------------------------- helper functions
 			}
 		}
 
+		delete_collapsed(v1, deadFaces);
+	}
+
+	/// Moves the edges of 'v1' to 'v2' (collapse with the edge index): an edge (v1,x) becomes
+	/// (v2,x), unless (v2,x) exists already, then the one of the two with the smaller index is
+	/// deleted and its faces (but the dead ones) move to the other, as in the scan above.
+	void merge_edges(Vertex v1, Vertex v2, const Face_set& deadFaces)
+	{
+		Edge_set moving = vconn_[v1].edges_;
+
+		for(typename Edge_set::iterator eit = moving.begin(); eit != moving.end(); eit++)
+		{
+			Edge ei = *eit;
+			Vertex x = other_vertex(ei, v1);
+			edge_index_.erase(v1.idx(), x.idx(), ei.idx());
+			replace_vertex(ei, v1, v2);
+
+			Edge ej(edge_index_.find(v2.idx(), x.idx()));
+			if(ej.idx() < 0)
+			{
+				set_edge(v2, ei);
+				edge_index_.insert(v2.idx(), x.idx(), ei.idx());
+				continue;
+			}
+
+			Edge dead = (ei < ej) ? ei : ej;
+			Edge live = (ei < ej) ? ej : ei;
+
+			for(typename Face_set::iterator fit = econn_[dead].faces_.begin(); fit != econn_[dead].faces_.end(); fit++)
+			{
+				if(deadFaces.find(*fit) == deadFaces.end())
+					set_face(live, *fit);
+			}
+
+			remove_edge(v2, dead);
+			remove_edge(x, dead);
+			set_edge(v2, live);
+			edge_index_.insert(v2.idx(), x.idx(), live.idx());
+			delete_edge(dead);
+		}
+	}
+
+	/// Deletes the collapsed vertex and the faces of the collapsed edge
+	void delete_collapsed(Vertex v1, const Face_set& deadFaces)
+	{
 		// Not sure why this is needed since defined in constructor..
 		// (just following Surface_mesh for now)
 		reserve_delete();
@@ -1464,7 +1647,7 @@ public: //--------------------------------------------------- helper functions
 		vdeleted_[v1]   = true; ++deleted_vertices_;
 
 
-		for(typename std::set<Face>::iterator fit = deadFaces.begin(); fit != deadFaces.end(); fit++)
+		for(typename Face_set::const_iterator fit = deadFaces.begin(); fit != deadFaces.end(); fit++)
 		{
 			if(!fdeleted_[*fit])
 			{
@@ -1495,7 +1678,7 @@ public: //--------------------------------------------------- helper functions
 	{
 		std::vector<Edge> result;
 
-		for(typename std::set<Edge>::iterator ei = vconn_[v].edges_.begin(); 
+		for(typename Edge_set::iterator ei = vconn_[v].edges_.begin(); 
 			ei != vconn_[v].edges_.end(); ei++)
 			result.push_back(*ei);
 
@@ -1513,6 +1696,7 @@ public: //--------------------------------------------------- helper functions
 		{
 			edeleted_[e]	= true; 
 			++deleted_edges_;
+			if(use_edge_index_) edge_index_.erase(vertex(e,0).idx(), vertex(e,1).idx(), e.idx());
 		}
 	}
 
@@ -1531,7 +1715,9 @@ public: //--------------------------------------------------- helper functions
     /// find the edge from start to end
 	Edge get_edge(Vertex start, Vertex end)
 	{
-		for(typename std::set<Edge>::iterator eit = vconn_[start].edges_.begin(); eit != vconn_[start].edges_.end(); eit++){
+		if(use_edge_index_) return Edge(edge_index_.find(start.idx(), end.idx()));
+
+		for(typename Edge_set::iterator eit = vconn_[start].edges_.begin(); eit != vconn_[start].edges_.end(); eit++){
 			if(edge_connects(*eit, start) && edge_connects(*eit, end))
 				return *eit;
 		}
@@ -1558,7 +1744,7 @@ public:  //--------------------------------------------------- public helper fun
 	{
 		std::set<Vertex> result;
 		
-		for(typename std::set<Edge>::iterator eit = vconn_[v].edges_.begin(); eit != vconn_[v].edges_.end(); eit++)
+		for(typename Edge_set::iterator eit = vconn_[v].edges_.begin(); eit != vconn_[v].edges_.end(); eit++)
 		{
 			Edge e = *eit;
 			result.insert(other_vertex(e, v));
@@ -1595,6 +1781,9 @@ protected: //------------------------------------------------------- private dat
 
     Vertex_property<Vector>   vpoint_;
 
+    EdgeIndex edge_index_;  ///< (vertex,vertex)=>edge, see use_edge_index()
+    bool use_edge_index_;
+
     unsigned int deleted_vertices_;
     unsigned int deleted_edges_;
     unsigned int deleted_faces_;
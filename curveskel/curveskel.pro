@@ -12,6 +12,8 @@ HEADERS += \
     global.h \
     Vector.h \
     WingedgeMesh.h \
+    SmallSet.h \
+    EdgeIndex.h \
     CurveskelModel.h \
     CurveskelPlugins.h \
     CurveskelTypes.h \
@@ -0,0 +1,222 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <utility>
+#include <cmath>
+#include <limits>
+
+/// KD-tree over points of fixed dimension DIM (coordinates of type T), laid out for cache
+/// efficiency: the points are copied once, packed and reordered so that each leaf is a
+/// contiguous bucket of up to "bucketsize" points; nodes are in one array, the two children of
+/// a node next to each other. Splits are at the median of the widest extent of the cell.
+///
+/// Queries are iterative (explicit stack) and keep their state on the stack of the caller: the
+/// tree is read-only after construction, thus it can be queried from several threads at once.
+/// Indexes returned are the positions of the points in the input array, distances are
+/// euclidean (not squared). Same queries as KDTree.h: closest_point, k_closest_points and
+/// ball_query, on points given as pointers to DIM coordinates; closest_points() answers a
+/// batch of queries in parallel.
+template <int DIM, class T = double>
+class FlatKDTree{
+private:
+    struct Node{
+        T split;      ///< inner: split value along dim
+        int dim;      ///< inner: split dimension, -1 for a leaf
+        int first;    ///< inner: index of the left child (right is first+1), leaf: first point
+        int count;    ///< leaf: number of points
+    };
+    std::vector<Node> nodes;  ///< nodes[0] is the root
+    std::vector<T> pts;       ///< points in leaf order, DIM coordinates each
+    std::vector<int> ids;     ///< input index of the points in leaf order
+    int bucketsize;
+
+    /// Max depth: the median split at least halves a cell
+    enum{ MAXDEPTH = 64 };
+    struct Entry{
+        int node;
+        T bound;  ///< squared distance from the query to the cell (lower bound)
+    };
+
+    static T sqr(T x){ return x*x; }
+
+    T distance_squared(const T* q, int i) const{
+        const T* p = &pts[DIM*i];
+        T d = 0;
+        for(int k = 0; k < DIM; k++) d += sqr(q[k]-p[k]);
+        return d;
+    }
+
+    /// Builds the subtree of the points order[begin...end-1] into nodes[inode]
+    void build(const T* xyz, std::vector<int>& order, int inode, int begin, int end){
+        if(end - begin <= bucketsize){
+            nodes[inode].dim = -1;
+            nodes[inode].first = begin;
+            nodes[inode].count = end - begin;
+            return;
+        }
+
+        /// Widest extent of the cell
+        T lo[DIM], hi[DIM];
+        for(int k = 0; k < DIM; k++) lo[k] = hi[k] = xyz[DIM*order[begin]+k];
+        for(int i = begin+1; i < end; i++)
+            for(int k = 0; k < DIM; k++){
+                T x = xyz[DIM*order[i]+k];
+                lo[k] = std::min(lo[k], x);
+                hi[k] = std::max(hi[k], x);
+            }
+        int dim = 0;
+        for(int k = 1; k < DIM; k++)
+            if(hi[k]-lo[k] > hi[dim]-lo[dim]) dim = k;
+
+        /// Median split (points equal to the median can be on both sides)
+        int mid = begin + (end-begin)/2;
+        CoordinateLess less(xyz, dim);
+        std::nth_element(order.begin()+begin, order.begin()+mid, order.begin()+end, less);
+
+        int first = nodes.size();
+        nodes.resize(first+2);
+        nodes[inode].split = xyz[DIM*order[mid]+dim];
+        nodes[inode].dim = dim;
+        nodes[inode].first = first;
+        nodes[inode].count = 0;
+        build(xyz, order, first, begin, mid);
+        build(xyz, order, first+1, mid, end);
+    }
+
+    struct CoordinateLess{
+        const T* xyz;
+        int dim;
+        CoordinateLess(const T* xyz, int dim) : xyz(xyz), dim(dim){}
+        bool operator()(int a, int b) const { return xyz[DIM*a+dim] < xyz[DIM*b+dim]; }
+    };
+
+public:
+    FlatKDTree() : bucketsize(8){}
+
+    /// Tree of the npoints points stored as consecutive DIM-tuples in xyz
+    FlatKDTree(const T* xyz, int npoints, int bucketsize = 8) : bucketsize(std::max(1,bucketsize)){
+        std::vector<int> order(npoints);
+        for(int i = 0; i < npoints; i++) order[i] = i;
+        nodes.reserve(2*(npoints/this->bucketsize+1));
+        nodes.resize(1);
+        build(xyz, order, 0, 0, npoints);
+
+        pts.resize(DIM*npoints);
+        for(int i = 0; i < npoints; i++)
+            for(int k = 0; k < DIM; k++) pts[DIM*i+k] = xyz[DIM*order[i]+k];
+        ids.swap(order);
+    }
+
+    int size() const { return ids.size(); }
+    int ndims() const { return DIM; }
+
+    /// Closest point to q (index and distance), -1 if the tree is empty
+    void closest_point(const T* q, int& idx, T& dist) const{
+        idx = -1;
+        T best = std::numeric_limits<T>::max();
+        Entry stack[MAXDEPTH];
+        int top = 0;
+        if(size() > 0){ stack[0].node = 0; stack[0].bound = 0; top = 1; }
+        while(top > 0){
+            Entry e = stack[--top];
+            if(e.bound >= best) continue;
+            const Node* node = &nodes[e.node];
+            while(node->dim >= 0){
+                T d = q[node->dim] - node->split;
+                int nearer = node->first + (d > 0 ? 1 : 0);
+                stack[top].node = node->first + (d > 0 ? 0 : 1);
+                stack[top].bound = std::max(e.bound, d*d);
+                if(stack[top].bound < best) top++;
+                node = &nodes[nearer];
+            }
+            for(int i = node->first; i < node->first+node->count; i++){
+                T d = distance_squared(q, i);
+                if(d < best){ best = d; idx = i; }
+            }
+        }
+        if(idx >= 0) idx = ids[idx];
+        dist = std::sqrt(best);
+    }
+
+    int closest_point(const T* q) const{
+        int idx;
+        T dist;
+        closest_point(q, idx, dist);
+        return idx;
+    }
+
+    /// Closest point of each of the n queries packed in q (DIM coordinates each) into idx[i]
+    /// and dist[i] (dist can be NULL). Queries are split among threads (OpenMP), in chunks of
+    /// consecutive ones: queries coming from a mesh or a skeleton are spatially coherent.
+    void closest_points(const T* q, int n, int* idx, T* dist) const{
+        #pragma omp parallel for schedule(dynamic,1024)
+        for(int i = 0; i < n; i++){
+            T d;
+            closest_point(q+DIM*i, idx[i], d);
+            if(dist) dist[i] = d;
+        }
+    }
+
+    /// The k closest points to q, closest first (appended to idxs/distances)
+    void k_closest_points(const T* q, int k, std::vector<int>& idxs, std::vector<T>& distances) const{
+        std::vector< std::pair<T,int> > heap;  // max-heap of the k best (squared distance, position)
+        heap.reserve(k+1);
+        Entry stack[MAXDEPTH];
+        int top = 0;
+        if(size() > 0 && k > 0){ stack[0].node = 0; stack[0].bound = 0; top = 1; }
+        while(top > 0){
+            Entry e = stack[--top];
+            if((int)heap.size() == k && e.bound >= heap.front().first) continue;
+            const Node* node = &nodes[e.node];
+            while(node->dim >= 0){
+                T d = q[node->dim] - node->split;
+                int nearer = node->first + (d > 0 ? 1 : 0);
+                stack[top].node = node->first + (d > 0 ? 0 : 1);
+                stack[top].bound = std::max(e.bound, d*d);
+                if((int)heap.size() < k || stack[top].bound < heap.front().first) top++;
+                node = &nodes[nearer];
+            }
+            for(int i = node->first; i < node->first+node->count; i++){
+                T d = distance_squared(q, i);
+                if((int)heap.size() < k){
+                    heap.push_back(std::make_pair(d,i));
+                    std::push_heap(heap.begin(), heap.end());
+                }
+                else if(d < heap.front().first){
+                    std::pop_heap(heap.begin(), heap.end());
+                    heap.back() = std::make_pair(d,i);
+                    std::push_heap(heap.begin(), heap.end());
+                }
+            }
+        }
+        std::sort_heap(heap.begin(), heap.end());
+        for(int i = 0; i < (int)heap.size(); i++){
+            idxs.push_back(ids[heap[i].second]);
+            distances.push_back(std::sqrt(heap[i].first));
+        }
+    }
+
+    /// All the points at distance at most radius from q (appended to idxs/distances, unsorted)
+    void ball_query(const T* q, T radius, std::vector<int>& idxs, std::vector<T>& distances) const{
+        T r2 = radius*radius;
+        int stack[MAXDEPTH];
+        int top = 0;
+        if(size() > 0) stack[top++] = 0;
+        while(top > 0){
+            const Node* node = &nodes[stack[--top]];
+            while(node->dim >= 0){
+                T d = q[node->dim] - node->split;
+                int nearer = node->first + (d > 0 ? 1 : 0);
+                if(d*d <= r2) stack[top++] = node->first + (d > 0 ? 0 : 1);
+                node = &nodes[nearer];
+            }
+            for(int i = node->first; i < node->first+node->count; i++){
+                T d = distance_squared(q, i);
+                if(d <= r2){
+                    idxs.push_back(ids[i]);
+                    distances.push_back(std::sqrt(d));
+                }
+            }
+        }
+    }
+};
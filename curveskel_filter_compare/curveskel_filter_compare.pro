@@ -1,7 +1,16 @@
 include($$[STARLAB])
 include($$[CURVESKEL])
 StarlabTemplate(plugin)
+CONFIG += c++11
 
-HEADERS += skeleton_compare.h
+HEADERS += skeleton_compare.h FlatKDTree.h
 SOURCES += skeleton_compare.cpp
 
+# OpenMP (batched closest point queries)
+unix:!macx{
+    QMAKE_CXXFLAGS += -fopenmp
+    QMAKE_LFLAGS += -fopenmp
+}
+win32{
+    QMAKE_CXXFLAGS += /openmp
+}
@@ -3,15 +3,9 @@
 #include <QMessageBox>
 #include "CurveskelModel.h"
 #include "CurveskelHelper.h"
-#include "KDTree.h"
+#include "FlatKDTree.h"
 #include "StarlabDrawArea.h"
 
-std::vector<double> toKDPoint(const CurveskelTypes::Point & from){
-    std::vector<double> p(3, 0.0);
-    p[0] = from.x(); p[1] = from.y(); p[2] = from.z();
-    return p;
-}
-
 void skeleton_compare::initParameters(RichParameterSet* pars){
     /// QMap of skeleton models indexed by name
     skeletons.clear();
@@ -41,32 +35,39 @@ void skeleton_compare::applyFilter(RichParameterSet* params){
     
     CurveskelModel* target = qobject_cast<CurveskelModel*>( model() );
     if(!target) throw StarlabException("Must be a skeleton model");
+    if(src->n_vertices()==0 || target->n_vertices()==0)
+        throw StarlabException("Cannot compare empty skeletons");
     
     CurveskelModel::Vertex_property<CurveskelTypes::Point> src_pnts = src->vertex_property<CurveskelTypes::Point>("v:point");
     CurveskelModel::Vertex_property<CurveskelTypes::Point> target_pnts = target->vertex_property<CurveskelTypes::Point>("v:point");
     
-    // Construct a kd-tree
-    std::vector<KDPoint> src_points;
+    // Construct a kd-tree (on packed coordinates)
+    std::vector<double> src_points;
+    src_points.reserve(3*src->n_vertices());
     foreach(CurveskelTypes::Vertex v, src->vertices())
-        src_points.push_back( toKDPoint(src_pnts[v]) );
-    KDTree src_tree(src_points);
+        for(int k=0; k<3; k++) src_points.push_back( src_pnts[v][k] );
+    FlatKDTree<3,double> src_tree(src_points.data(), src->n_vertices());
 
-    // Common variables
-    int closeidx = -1;
-    double di = 0.0;
+    // Closest source point of every target point (batched, in parallel)
+    std::vector<double> target_points;
+    target_points.reserve(3*target->n_vertices());
+    foreach(CurveskelTypes::Vertex v, target->vertices())
+        for(int k=0; k<3; k++) target_points.push_back( target_pnts[v][k] );
+    int ntarget = target->n_vertices();
+    std::vector<int> closeidx(ntarget, -1);
+    std::vector<double> di(ntarget, 0.0);
+    src_tree.closest_points(target_points.data(), ntarget, closeidx.data(), di.data());
 
     // Compare target points
     double avgDifference=0.0;
     {
-        foreach(CurveskelTypes::Vertex v, target->vertices()){
-            // Locate closest point, return distance
-            src_tree.closest_point( toKDPoint( target_pnts[v] ), closeidx, di);
-            avgDifference += di;
+        for(int i=0; i<ntarget; i++){
+            avgDifference += di[i];
             
             //if(show_measurements)
-            //    drawArea()->drawSegment( target_pnts[v], src_pnts[ CurveskelTypes::Vertex(closeidx) ], 2, Qt::blue);
+            //    drawArea()->drawSegment( target_pnts[Vertex(i)], src_pnts[ CurveskelTypes::Vertex(closeidx[i]) ], 2, Qt::blue);
         }
-        avgDifference /= target->n_vertices();
+        avgDifference /= ntarget;
         double bbox_diag = src->bbox().diagonal().norm();
         avgDifference /= bbox_diag;
     }
@@ -0,0 +1,51 @@
+#pragma once
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include "CurveskelQForEach.h"
+
+/// Writes the surface vertices of each node (if known) next to the skeleton, in path with the
+/// .corr extension: one line per node, "c" followed by the (0-based) indices of the vertices of
+/// the original surface mapped to it.
+inline void write_corr(CurveskelTypes::CurveskelModel* skel, QString path){
+    QFile out(path);
+    out.open(QIODevice::WriteOnly | QIODevice::Text);
+    out.write(qPrintable(QString("# NV:%1 NS:%2\n").arg(skel->n_vertices()).arg(skel->samples.size())));
+    for(uint v = 0; v < skel->n_vertices(); v++){
+        QString line = "c";
+        for(int k = skel->samples_offset[v]; k < skel->samples_offset[v+1]; k++)
+            line += " " + QString::number(skel->samples[k]);
+        out.write(qPrintable(line+"\n"));
+    }
+    out.close();
+}
+
+/// Writes a skeleton in the Curve Graph (*.cg) format. Deleted elements are garbage collected
+/// first. Shared by the I/O plugin and by the batch skeletonizer. The correspondences are saved
+/// alongside (see write_corr).
+inline void write_cg(CurveskelTypes::CurveskelModel* skel, QString path){
+    using namespace CurveskelTypes;
+    CurveskelModel::Vertex_property<CurveskelTypes::Point> pnts = skel->vertex_property<CurveskelTypes::Point>("v:point");
+    skel->garbage_collection();
+
+    QFile out(path);
+    out.open(QIODevice::WriteOnly | QIODevice::Text);
+
+    // Header
+    out.write(qPrintable(QString("# D:3 NV:%1 NE:%2\n").arg(skel->n_vertices()).arg(skel->n_edges())));
+
+    // Vertices
+    foreach(CurveskelModel::Vertex v, skel->vertices())
+        out.write(qPrintable(QString("v %1 %2 %3\n").arg(pnts[v].x()).arg(pnts[v].y()).arg(pnts[v].z())));
+
+    // Edges (index from 1)
+    foreach(CurveskelModel::Edge e, skel->edges())
+        out.write(qPrintable(QString("e %1 %2\n").arg(1+skel->vertex(e,0).idx()).arg(1+skel->vertex(e,1).idx())));
+
+    out.close();
+
+    if(skel->has_samples()){
+        QFileInfo fi(path);
+        write_corr(skel, QDir(fi.absolutePath()).filePath(fi.completeBaseName()+".corr"));
+    }
+}
@@ -2,6 +2,7 @@
 #include "curveskel_io_cg.h"
 #include "Document.h"
 #include "CurveskelHelper.h"
+#include "CgWriter.h"
 #include <fstream>
 
 using namespace CurveskelTypes;
@@ -65,22 +66,5 @@ Starlab::Model *curveskel_io_cg::open(QString path){
 
 void curveskel_io_cg::save(CurveskelModel* skel, QString path)
 {
-    CurveskelModel::Vertex_property<CurveskelTypes::Point> pnts = skel->vertex_property<CurveskelTypes::Point>("v:point");
-    skel->garbage_collection();
-
-    QFile out(path);
-    out.open(QIODevice::WriteOnly | QIODevice::Text);
-
-    // Header
-    out.write(qPrintable(QString("# D:3 NV:%1 NE:%2\n").arg(skel->n_vertices()).arg(skel->n_edges())));
-
-    // Vertices
-    foreach(CurveskelModel::Vertex v, skel->vertices())
-        out.write(qPrintable(QString("v %1 %2 %3\n").arg(pnts[v].x()).arg(pnts[v].y()).arg(pnts[v].z())));
-
-    // Edges (index from 1)
-    foreach(CurveskelModel::Edge e, skel->edges())
-        out.write(qPrintable(QString("e %1 %2\n").arg(1+skel->vertex(e,0).idx()).arg(1+skel->vertex(e,1).idx())));
-
-    out.close();
+    write_cg(skel,path);
 }
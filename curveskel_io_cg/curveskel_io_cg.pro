@@ -2,5 +2,5 @@ include($$[STARLAB])
 include($$[CURVESKEL])
 StarlabTemplate(plugin)
 
-HEADERS += curveskel_io_cg.h
+HEADERS += curveskel_io_cg.h CgWriter.h
 SOURCES += curveskel_io_cg.cpp 
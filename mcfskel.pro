@@ -14,3 +14,6 @@ SUBDIRS += curveskel_filter_compare
 SUBDIRS += surfacemesh_filter_to_skeleton
 SUBDIRS += surfacemesh_filter_voromat
 SUBDIRS += surfacemesh_filter_mcfskel
+
+# Command line skeletonizer (voromat => MCF => skeleton => cg) built on the plugins' helpers
+SUBDIRS += mcfskel_batch
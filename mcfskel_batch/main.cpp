@@ -0,0 +1,138 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutex>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+#include "StarlabException.h"
+#include "QhullVoronoiHelper.h"
+#include "SkelcollapseHelper.h"
+#include "ToSkeletonHelper.h"
+#include "CgWriter.h"
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/// The (old) qhull C++ interface keeps global state: one voronoi diagram at a time
+static QMutex qhullMutex;
+
+/// voromat => MCF => skeleton => cg, on one mesh. Runs on a thread of the pool.
+class Skeletonize{
+public:
+    typedef QString result_type;
+    QString outdir;      ///< empty: next to the input
+    int maxIterations;
+    int ompThreads;      ///< threads of the OpenMP loops within one mesh
+    Skeletonize(QString outdir, int maxIterations, int ompThreads) : outdir(outdir), maxIterations(maxIterations), ompThreads(ompThreads){}
+
+    QString operator()(const QString& path) const{
+#ifdef _OPENMP
+        /// Per thread setting: the pool threads do not inherit it from main()
+        omp_set_num_threads(ompThreads);
+#endif
+        QFileInfo fi(path);
+        QString dir = outdir.isEmpty() ? fi.absolutePath() : outdir;
+        QString basename = QDir(dir).filePath(fi.completeBaseName());
+        try{
+            SurfaceMeshModel mesh(path,fi.baseName());
+            if(!mesh.read(qPrintable(path)))
+                return "[FAILED] "+path+": cannot read mesh";
+            mesh.updateBoundingBox();
+
+            /// One log per mesh (the log is per thread)
+            tictocreset(basename+".log");
+
+            { /// Medial poles (as in voromat, no embedding)
+                tic("Voronoi Poles");
+                mesh.update_face_normals();
+                mesh.update_vertex_normals();
+                VoronoiHelper h(&mesh,NULL);
+                {
+                    QMutexLocker locker(&qhullMutex);
+                    h.computeVoronoiDiagram();
+                }
+                h.searchVoronoiPoles();
+                h.getMedialSpokeAngleAndRadii();
+                h.setToMedial(false);
+                toc();
+            }
+
+            { /// Mean curvature flow to convergence
+                SkelcollapseHelper skelcollapse(&mesh);
+                skelcollapse.maxIterations = maxIterations;
+                skelcollapse.setup();
+                skelcollapse.algorithm_converge();
+            }
+
+            { /// Curve skeleton
+                tic("Skeleton Conversion");
+                CurveskelTypes::CurveskelModel* skel = ToSkeletonHelper(&mesh).convert();
+                write_cg(skel,basename+".cg");
+                delete skel;
+                toc();
+            }
+        } catch(StarlabException& e){
+            return "[FAILED] "+path+": "+e.what();
+        }
+        return "[OK] "+path+" => "+basename+".cg";
+    }
+};
+
+int main(int argc, char *argv[]){
+    QCoreApplication app(argc,argv);
+    app.setApplicationName("mcfskel_batch");
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Mean curvature skeletons of OFF/OBJ meshes, saved as .cg");
+    parser.addHelpOption();
+    parser.addPositionalArgument("input","Meshes, or directories of meshes","input...");
+    QCommandLineOption outdirOption(QStringList() << "o" << "output","Output directory (default: next to the input)","dir");
+    QCommandLineOption threadsOption(QStringList() << "j" << "threads","Meshes processed concurrently (default: #cores); the cores are split among them for the parallel loops within a mesh","n");
+    QCommandLineOption iterationsOption("iterations","Maximum number of MCF iterations (default: 500)","n","500");
+    parser.addOption(outdirOption);
+    parser.addOption(threadsOption);
+    parser.addOption(iterationsOption);
+    parser.process(app);
+
+    /// Collect the meshes
+    QStringList paths;
+    QStringList filters = QStringList() << "*.off" << "*.obj";
+    foreach(QString input, parser.positionalArguments()){
+        QFileInfo fi(input);
+        if(fi.isDir()){
+            foreach(QFileInfo f, QDir(input).entryInfoList(filters,QDir::Files,QDir::Name))
+                paths << f.absoluteFilePath();
+        } else if(fi.exists()){
+            paths << fi.absoluteFilePath();
+        } else {
+            qWarning("No such file: %s",qPrintable(input));
+        }
+    }
+    if(paths.isEmpty())
+        parser.showHelp(1);
+
+    if(parser.isSet(threadsOption))
+        QThreadPool::globalInstance()->setMaxThreadCount(parser.value(threadsOption).toInt());
+
+    /// Meshes x OpenMP threads per mesh stays within the cores (no oversubscription): with the
+    /// default pool every mesh runs its loops serially, with -j 1 a mesh uses all the cores
+    int nmeshes = std::max(1, std::min(QThreadPool::globalInstance()->maxThreadCount(), (int)paths.size()));
+    int ompThreads = std::max(1, QThread::idealThreadCount()/nmeshes);
+
+    QString outdir = parser.value(outdirOption);
+    if(!outdir.isEmpty())
+        QDir().mkpath(outdir);
+
+    /// Process them concurrently
+    int maxIterations = parser.value(iterationsOption).toInt();
+    QStringList results = QtConcurrent::blockingMapped(paths,Skeletonize(outdir,maxIterations,ompThreads));
+
+    int nfailed = 0;
+    foreach(QString result, results){
+        qDebug() << qPrintable(result);
+        if(result.startsWith("[FAILED]")) nfailed++;
+    }
+    return (nfailed>0) ? 1 : 0;
+}
@@ -0,0 +1,39 @@
+include($$[STARLAB])
+include($$[CHOLMOD])
+include($$[SURFACEMESH])
+include($$[CURVESKEL])
+include($$[QHULL])
+StarlabTemplate(appbundle)
+
+# Command line tool: no GUI, no bundle
+CONFIG += console
+CONFIG -= app_bundle
+CONFIG += c++11
+QT += concurrent
+
+# Keep in sync with surfacemesh_filter_mcfskel.pro
+CONFIG += cholmod
+CONFIG(cholmod){
+    DEFINES += USE_CHOLMOD
+}
+
+# OpenMP (cotangent weights, pole search)
+unix:!macx{
+    QMAKE_CXXFLAGS += -fopenmp
+    QMAKE_LFLAGS += -fopenmp
+}
+win32{
+    QMAKE_CXXFLAGS += /openmp
+}
+
+# The algorithms are shared with the plugins
+INCLUDEPATH += \
+    $$PWD/../surfacemesh_filter_voromat \
+    $$PWD/../surfacemesh_filter_mcfskel \
+    $$PWD/../surfacemesh_filter_to_skeleton \
+    $$PWD/../curveskel_io_cg
+
+SOURCES += \
+    main.cpp \
+    ../surfacemesh_filter_mcfskel/SkelcollapseHelper.cpp \
+    ../surfacemesh_filter_mcfskel/Logfile.cpp
@@ -0,0 +1,144 @@
+#pragma once
+#include <QString>
+#include <QStringList>
+#include <Eigen/Core>
+#include <Eigen/Sparse>
+#ifdef USE_CHOLMOD
+    #include <Eigen/CholmodSupport>
+#endif
+#include "StarlabException.h"
+
+/// Names of the available backends (as shown in the filter parameters)
+const QString SOLVER_LDLT    = "Eigen LDLT";
+const QString SOLVER_CHOLMOD = "CHOLMOD supernodal";
+const QString SOLVER_PCG     = "PCG (warm start)";
+
+/// Solves the (symmetric, upper triangle only) normal equations of the contraction step.
+/// The symbolic analysis is separated from the numeric factorization so that it can be
+/// reused across iterations with unchanged connectivity.
+class ContractionSolver{
+public:
+    typedef Eigen::SparseMatrix<double> SparseMatrix;
+    typedef Eigen::MatrixXd Matrix;
+    typedef Eigen::PermutationMatrix<Eigen::Dynamic,Eigen::Dynamic,int> Permutation;
+
+    virtual ~ContractionSolver(){}
+    /// P maps rows to their elimination position. If given (non-empty) it is used as the
+    /// fill-reducing ordering, otherwise the one computed is returned in it. Backends that
+    /// take care of the ordering internally leave it empty.
+    virtual void analyzePattern(const SparseMatrix& AtA, Permutation& P) = 0;
+    virtual void factorize(const SparseMatrix& AtA) = 0;
+    /// Number of non-zeros in the factor (-1 if not a direct solver)
+    virtual int factorNonZeros(){ return -1; }
+    /// On input X holds the previous solution (used by iterative backends as initial guess)
+    virtual void solve(const Matrix& B, Matrix& X) = 0;
+
+    /// Backends available in this build
+    static QStringList names(){
+        QStringList retval;
+        retval << SOLVER_LDLT;
+#ifdef USE_CHOLMOD
+        retval << SOLVER_CHOLMOD;
+#endif
+        retval << SOLVER_PCG;
+        return retval;
+    }
+    static ContractionSolver* create(QString name);
+};
+
+/// Simplicial LDL^T, the three coordinates are solved together. The ordering is applied
+/// here rather than by eigen so that it can be supplied from the outside.
+class LDLTContractionSolver : public ContractionSolver{
+public:
+    typedef Eigen::SimplicialLDLT< SparseMatrix, Eigen::Upper, Eigen::NaturalOrdering<int> > Solver;
+    Solver solver;
+
+private:
+    Permutation P, Pinv;
+    SparseMatrix PAPt; ///< upper triangle of P*AtA*P^T
+
+    void permute(const SparseMatrix& AtA){
+        PAPt.resize(AtA.rows(),AtA.cols());
+        PAPt.selfadjointView<Eigen::Upper>() = AtA.selfadjointView<Eigen::Upper>().twistedBy(P);
+    }
+
+public:
+    void analyzePattern(const SparseMatrix& AtA, Permutation& ordering){
+        if(ordering.size()==0){
+            Eigen::AMDOrdering<int>()(AtA.selfadjointView<Eigen::Upper>(), Pinv);
+            ordering = Pinv.inverse();
+        }
+        P = ordering;
+        Pinv = P.inverse();
+        permute(AtA);
+        solver.analyzePattern(PAPt);
+    }
+    void factorize(const SparseMatrix& AtA){
+        permute(AtA);
+        solver.factorize(PAPt);
+    }
+    int factorNonZeros(){ return solver.matrixL().nestedExpression().nonZeros(); }
+
+    /// Solves for all the columns of B at once. Each entry of the factor P^T*L*D*L^T*P is
+    /// loaded once and updates the three coordinates of a row, rather than streaming the
+    /// whole factor through the cache once per coordinate as solver.solve() would.
+    void solve(const Matrix& B, Matrix& X){
+        typedef Eigen::Matrix<double,Eigen::Dynamic,3,Eigen::RowMajor> MatrixX3r;
+        typedef SparseMatrix::InnerIterator InnerIterator;
+        const SparseMatrix& L = solver.matrixL().nestedExpression(); ///< strictly lower, unit diagonal
+        MatrixX3r Y = P * B;
+
+        /// Forward substitution (L is stored by columns)
+        for(int j=0; j<L.outerSize(); j++)
+            for(InnerIterator it(L,j); it; ++it)
+                Y.row(it.row()) -= it.value() * Y.row(j);
+
+        /// Diagonal
+        Y = solver.vectorD().cwiseInverse().asDiagonal() * Y;
+
+        /// Backward substitution (columns of L are rows of L^T)
+        for(int j=L.outerSize()-1; j>=0; j--)
+            for(InnerIterator it(L,j); it; ++it)
+                Y.row(j) -= it.value() * Y.row(it.row());
+
+        X = Pinv * Y;
+    }
+};
+
+#ifdef USE_CHOLMOD
+/// Supernodal Cholesky, the dense supernodal blocks are processed by (multithreaded) BLAS
+class CholmodContractionSolver : public ContractionSolver{
+public:
+    typedef Eigen::CholmodSupernodalLLT< SparseMatrix, Eigen::Upper > Solver;
+    Solver solver;
+
+    void analyzePattern(const SparseMatrix& AtA, Permutation& /*P*/){ solver.analyzePattern(AtA); }
+    void factorize(const SparseMatrix& AtA){ solver.factorize(AtA); }
+    void solve(const Matrix& B, Matrix& X){ X = solver.solve(B); }
+};
+#endif
+
+/// Jacobi preconditioned conjugate gradients. Late MCF iterations barely move the vertices,
+/// so starting from the previous positions only a handful of iterations are needed.
+class PCGContractionSolver : public ContractionSolver{
+public:
+    typedef Eigen::ConjugateGradient< SparseMatrix, Eigen::Upper > Solver;
+    Solver solver;
+
+    PCGContractionSolver(){ solver.setTolerance(1e-10); }
+    void analyzePattern(const SparseMatrix& AtA, Permutation& /*P*/){ solver.analyzePattern(AtA); }
+    void factorize(const SparseMatrix& AtA){ solver.factorize(AtA); }
+    void solve(const Matrix& B, Matrix& X){
+        Matrix guess = X;
+        X = solver.solveWithGuess(B, guess);
+    }
+};
+
+inline ContractionSolver* ContractionSolver::create(QString name){
+    if(name==SOLVER_LDLT) return new LDLTContractionSolver();
+#ifdef USE_CHOLMOD
+    if(name==SOLVER_CHOLMOD) return new CholmodContractionSolver();
+#endif
+    if(name==SOLVER_PCG) return new PCGContractionSolver();
+    throw StarlabException(qPrintable("Contraction solver not available: "+name));
+}
@@ -0,0 +1,117 @@
+#pragma once
+#include <vector>
+#include <Eigen/Core>
+#include "SurfaceMeshHelper.h"
+
+/// Per-vertex state of the contraction step packed in contiguous arrays (one per quantity, and
+/// one per coordinate), so that the assembly of the system is a linear scan rather than a
+/// property lookup per access. Rows are the live vertices in handle order (deleted vertices are
+/// skipped), this also replaces the "v:index" property.
+///
+/// The connectivity (row<->handle maps and one-rings) is repacked only when the topology of the
+/// mesh changed ("topologyVersion", bumped by TopologyJanitor); the values are gathered again at
+/// every iteration, as both the flow and the janitor move the vertices.
+class ContractionWorkspace{
+public:
+    /// @{ connectivity, see repack()
+        std::vector<int> handle;        ///< row => vertex handle
+        std::vector<int> row;           ///< vertex handle => row (-1 if deleted)
+        std::vector<int> ring_offset;   ///< one-ring of row r is ring_offset[r]...ring_offset[r+1]-1
+        std::vector<int> ring_row;      ///< row of the neighbor
+        std::vector<int> ring_hedge;    ///< halfedge from the vertex to the neighbor
+    /// @}
+
+    /// @{ values, see gather()
+        std::vector<double> ring_weight;   ///< laplacian weight of ring_hedge
+        std::vector<double> omega_L;
+        std::vector<double> omega_H;
+        std::vector<double> omega_P;
+        Eigen::MatrixXd poles;             ///< rows x 3, column major (one array per coordinate)
+        Eigen::MatrixXd positions[2];      ///< double buffered: current() is read by the assembly,
+                                           ///< next() receives the solution, then swap()
+    /// @}
+
+private:
+    SurfaceMeshModel* mesh;    ///< mesh the connectivity refers to
+    int topologyVersion;       ///< its version
+    int nhalfedges;            ///< its number of (live) halfedges
+    int icurrent;
+
+public:
+    ContractionWorkspace() : mesh(NULL), topologyVersion(-1), nhalfedges(-1), icurrent(0){}
+
+    int rows() const { return (int) handle.size(); }
+    Eigen::MatrixXd& current(){ return positions[icurrent]; }
+    Eigen::MatrixXd& next(){ return positions[1-icurrent]; }
+    void swap(){ icurrent = 1-icurrent; }
+
+    /// Rebuilds the connectivity if the mesh or its topology changed, true if it did so
+    bool repack(SurfaceMeshModel* mesh){
+        int version = mesh->property("topologyVersion").toInt();
+        bool valid = (this->mesh==mesh) && (topologyVersion==version)
+                  && (rows()==(int)mesh->n_vertices()) && (nhalfedges==(int)mesh->n_halfedges())
+                  && (row.size()==mesh->vertices_size());
+        if(valid) return false;
+
+        handle.clear();
+        handle.reserve(mesh->n_vertices());
+        row.assign(mesh->vertices_size(), -1);
+        foreach(Surface_mesh::Vertex v, mesh->vertices()){
+            row[v.idx()] = handle.size();
+            handle.push_back(v.idx());
+        }
+
+        int n = rows();
+        ring_offset.resize(n+1);
+        ring_row.clear();
+        ring_hedge.clear();
+        ring_row.reserve(mesh->n_halfedges());
+        ring_hedge.reserve(mesh->n_halfedges());
+        ring_offset[0] = 0;
+        for(int r=0; r<n; r++){
+            foreach(Surface_mesh::Halfedge h, mesh->onering_hedges(Surface_mesh::Vertex(handle[r]))){
+                ring_row.push_back(row[mesh->to_vertex(h).idx()]);
+                ring_hedge.push_back(h.idx());
+            }
+            ring_offset[r+1] = ring_row.size();
+        }
+
+        ring_weight.resize(ring_row.size());
+        omega_L.resize(n);
+        omega_H.resize(n);
+        omega_P.resize(n);
+        poles.resize(n,3);
+        positions[0].resize(n,3);
+        positions[1].resize(n,3);
+
+        this->mesh = mesh;
+        topologyVersion = version;
+        nhalfedges = mesh->n_halfedges();
+        return true;
+    }
+
+    /// Packs the current values of the per-vertex (and per-halfedge) properties
+    void gather(ScalarHalfedgeProperty hweight, ScalarVertexProperty omega_L, ScalarVertexProperty omega_H, ScalarVertexProperty omega_P, Vector3VertexProperty poles, Vector3VertexProperty points){
+        int n = rows();
+        for(int k=0; k<(int)ring_hedge.size(); k++)
+            ring_weight[k] = hweight[Surface_mesh::Halfedge(ring_hedge[k])];
+        Eigen::MatrixXd& X = current();
+        for(int r=0; r<n; r++){
+            Surface_mesh::Vertex v(handle[r]);
+            this->omega_L[r] = omega_L[v];
+            this->omega_H[r] = omega_H[v];
+            this->omega_P[r] = omega_P[v];
+            for(int c=0; c<3; c++){
+                this->poles(r,c) = poles[v][c];
+                X(r,c) = points[v][c];
+            }
+        }
+    }
+
+    /// Writes the current positions back to the mesh
+    void scatter(Vector3VertexProperty points){
+        Eigen::MatrixXd& X = current();
+        for(int r=0; r<rows(); r++)
+            points[Surface_mesh::Vertex(handle[r])] = Vector3(X(r,0), X(r,1), X(r,2));
+    }
+};
@@ -0,0 +1,93 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include "SurfaceMeshHelper.h"
+
+/// Which vertices of the original surface each vertex of the contracted mesh stands for.
+///
+/// A disjoint-set forest over vertex handles, stored in two int vertex properties:
+/// "v:corrs-parent" (-1 for a root) and "v:corrs-rank". Every vertex starts as a singleton and
+/// a collapse merges the set of the removed vertex into the one of the survivor, in
+/// O(alpha(n)) amortized (union by rank, path compression). As a collapse removes a vertex of a set with exactly one
+/// live vertex, every set keeps exactly one live vertex. Since the mesh is not garbage collected
+/// during the flow, the handles of the original vertices stay valid; the per-vertex lists are
+/// only built by materialize() when they are needed.
+class CorrespondenceTracker{
+public:
+    typedef Surface_mesh::Vertex_property<int> IntVertexProperty;
+
+private:
+    SurfaceMeshModel* mesh;
+    IntVertexProperty parent;
+    IntVertexProperty rank;
+
+public:
+    /// Creates the forest (all singletons) if the mesh does not have it yet
+    CorrespondenceTracker(SurfaceMeshModel* mesh) : mesh(mesh){
+        parent = mesh->vertex_property<int>("v:corrs-parent",-1);
+        rank   = mesh->vertex_property<int>("v:corrs-rank",0);
+    }
+
+    /// Removes the forest from the mesh. To be done when the mesh is garbage collected: the
+    /// forest stores handles of the original vertices, which the compaction invalidates.
+    static void remove(SurfaceMeshModel* mesh){
+        IntVertexProperty parent = mesh->get_vertex_property<int>("v:corrs-parent");
+        IntVertexProperty rank   = mesh->get_vertex_property<int>("v:corrs-rank");
+        if(parent) mesh->remove_vertex_property(parent);
+        if(rank) mesh->remove_vertex_property(rank);
+    }
+
+    /// Representative of the set of v (path halving)
+    int find(int v){
+        while(parent[Surface_mesh::Vertex(v)] >= 0){
+            int p = parent[Surface_mesh::Vertex(v)];
+            int gp = parent[Surface_mesh::Vertex(p)];
+            if(gp >= 0) parent[Surface_mesh::Vertex(v)] = gp;
+            v = (gp >= 0) ? gp : p;
+        }
+        return v;
+    }
+
+    /// The (collapsed) vertex from now on corresponds to the same vertices as the survivor
+    void merge(Surface_mesh::Vertex from, Surface_mesh::Vertex into){
+        Surface_mesh::Vertex a(find(from.idx()));
+        Surface_mesh::Vertex b(find(into.idx()));
+        if(a == b) return;
+        if(rank[a] < rank[b]) std::swap(a,b);
+        parent[b] = a.idx();
+        if(rank[a] == rank[b]) rank[a]++;
+    }
+
+    /// Groups the original vertices by the live vertex they collapsed into. Live vertices are
+    /// numbered in handle order, their number is stored in "v:corrs-group" (-1 for the deleted
+    /// ones); the original vertices of group g are samples[offset[g]...offset[g+1]-1], by handle.
+    /// Vertices inserted by edge splits (see "v:issplit") are not original, thus not listed.
+    void materialize(std::vector<int>& offset, std::vector<int>& samples){
+        IntVertexProperty group = mesh->vertex_property<int>("v:corrs-group",-1);
+        Surface_mesh::Vertex_property<bool> vissplit = mesh->get_vertex_property<bool>("v:issplit");
+        int nhandles = mesh->vertices_size();
+
+        /// Number the live vertices, through their representative
+        std::vector<int> groupof(nhandles,-1);
+        int ngroups = 0;
+        for(int i=0; i<nhandles; i++) group[Surface_mesh::Vertex(i)] = -1;
+        foreach(Surface_mesh::Vertex v, mesh->vertices()){
+            group[v] = ngroups;
+            groupof[find(v.idx())] = ngroups++;
+        }
+
+        /// Counting sort of the original vertices by group
+        std::vector<int> gidx(nhandles,-1);
+        offset.assign(ngroups+1,0);
+        for(int i=0; i<nhandles; i++){
+            if(vissplit && vissplit[Surface_mesh::Vertex(i)]) continue;
+            gidx[i] = groupof[find(i)];
+            if(gidx[i] >= 0) offset[gidx[i]+1]++;
+        }
+        for(int g=0; g<ngroups; g++) offset[g+1] += offset[g];
+        samples.resize(offset[ngroups]);
+        std::vector<int> next(offset.begin(), offset.end()-1);
+        for(int i=0; i<nhandles; i++)
+            if(gidx[i] >= 0) samples[ next[gidx[i]]++ ] = i;
+    }
+};
@@ -4,12 +4,23 @@ class  CotangentLaplacianHelper : public SurfaceMeshHelper{
 public:
     CotangentLaplacianHelper(SurfaceMeshModel* mesh) : SurfaceMeshHelper(mesh){}
         
+    /// Each edge weight is computed once, edges are processed in parallel (OpenMP)
     ScalarHalfedgeProperty computeCotangentEdgeWeights(const std::string property="e:weight"){
         ScalarHalfedgeProperty hweight = mesh->add_halfedge_property<Scalar>(property);
-        foreach(Edge e, mesh->edges()){
-            hweight[ mesh->halfedge(e,0) ] = cotangentLaplacianWeight(e);
-            hweight[ mesh->halfedge(e,1) ] = cotangentLaplacianWeight(e);
+        int nedges = mesh->edges_size();
+        int nboundary = 0;
+        eweight.resize(nedges);
+        #pragma omp parallel for reduction(+:nboundary)
+        for(int i=0; i<nedges; i++){
+            Edge e(i);
+            if(mesh->is_deleted(e)) continue;
+            if(mesh->is_boundary(mesh->halfedge(e,0)) || mesh->is_boundary(mesh->halfedge(e,1))){ nboundary++; continue; }
+            eweight[i] = cotangentLaplacianWeight(e);
+            hweight[ mesh->halfedge(e,0) ] = eweight[i];
+            hweight[ mesh->halfedge(e,1) ] = eweight[i];
         }
+        if(nboundary>0)
+            throw StarlabException("Not supported here!!! (mesh with boundary? try to clean with MeshFix, an external program)");
         return hweight;
     }
     
@@ -21,52 +32,30 @@ public:
     }
     
 protected:
+    std::vector<Scalar> eweight; ///< cotangent weights indexed by edge
+
+    /// Cotangent of the angle between d0 and d1, as dot/|cross|. It is bounded as the cosine
+    /// used to be (in [-0.999,0.999]) for robustness.
+    static Scalar cotangent(const Vector3& d0, const Vector3& d1){
+        const Scalar ub = 0.999/sqrt(1-0.999*0.999);
+        Scalar c = dot(d0,d1);
+        Scalar s = cross(d0,d1).norm();
+        if(s==0) return (c>0) ? ub : ((c<0) ? -ub : 0);
+        return qBound(-ub, c/s, ub);
+    }
+
+    /// Sum of the cotangents of the angles opposite to a (non boundary) edge
     Scalar cotangentLaplacianWeight(Edge eit){
-        Surface_mesh::Vertex_property<Point> points = mesh->vertex_property<Point>("v:point");
-       
-        bool secure = true;
-        
-        Scalar lb(-0.999), ub(0.999);        
-        Scalar w  = 0.0;
-        Surface_mesh::Halfedge h0 = mesh->halfedge(eit, 0);
-        Surface_mesh::Vertex   v0 = mesh->to_vertex(h0);
-        Point p0 = points[v0];
-        
-        Surface_mesh::Halfedge h1 = mesh->halfedge(eit, 1);
-        Surface_mesh::Vertex   v1 = mesh->to_vertex(h1);
-        Point p1 = points[v1];
-        
-        if(mesh->is_boundary(h0) || mesh->is_boundary(h1))
-            throw StarlabException("Not supported here!!! (mesh with boundary? try to clean with MeshFix, an external program)");
-            
-        if (!mesh->is_boundary(h0))
-        {
-            Point p2 = points[mesh->to_vertex(mesh->next_halfedge(h0))];
-            Point d0 = (p0 - p2).normalized();
-            Point d1 = (p1 - p2).normalized();
-            Scalar c  = dot(d0,d1);
-            if(secure){
-                c = (c<lb) ? lb:c;
-                c = (c>ub) ? ub:c;
-            }
-            w += 1.0 / tan(acos(c));
-        }
-        
-        if (!mesh->is_boundary(h1))
-        {
-            Point p2 = points[mesh->to_vertex(mesh->next_halfedge(h1))];
-            Point d0 = (p0 - p2).normalized();
-            Point d1 = (p1 - p2).normalized();
-            Scalar c  = dot(d0,d1);
-            if(secure){
-                c = (c<lb) ? lb:c;
-                c = (c>ub) ? ub:c;
-            }
-            w += 1.0 / tan(acos(c));
-        }
+        Halfedge h0 = mesh->halfedge(eit, 0);
+        Halfedge h1 = mesh->halfedge(eit, 1);
+        Point p0 = points[mesh->to_vertex(h0)];
+        Point p1 = points[mesh->to_vertex(h1)];
+        Point p2 = points[mesh->to_vertex(mesh->next_halfedge(h0))];
+        Point p3 = points[mesh->to_vertex(mesh->next_halfedge(h1))];
+        Scalar w = cotangent(p0-p2, p1-p2) + cotangent(p0-p3, p1-p3);
         
         // force weights to be non-negative for higher robustness
-        if(secure) if (w < 0.0) w = 0.0;
+        if (w < 0.0) w = 0.0;
         return w;
     }
     
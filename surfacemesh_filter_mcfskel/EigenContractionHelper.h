@@ -1,172 +1,313 @@
 #pragma once
 
 #include <iomanip>
+#include <algorithm>
 #include <QElapsedTimer>
 #include <Eigen/Core>
 #include <Eigen/Sparse>
 #include "SurfaceMeshHelper.h"
 #include "CotangentLaplacianHelper.h"
+#include "ContractionSolver.h"
+#include "ContractionWorkspace.h"
 #include "Logfile.h"
 
 using namespace Eigen;
 
+/// Solver state that outlives a single MCF iteration. The symbolic analysis (fill-reducing
+/// ordering and elimination tree) only depends on the connectivity of the mesh, thus it is
+/// redone only when TopologyJanitor has collapsed/split something (see "topologyVersion")
+///
+/// The cotangent weights move with the vertices, so every entry of the factor changes at each
+/// iteration and has to be recomputed. What survives a cleanup that touched only a few vertices
+/// is the elimination order: in incremental mode it is kept (by vertex handle), the deleted
+/// vertices are dropped and the new ones are eliminated right after their neighbors. A fresh
+/// ordering is computed when too much changed or when the factor fills in too much, and when the
+/// handles were renumbered by a garbage collection ("handlesVersion", bumped by whoever compacts
+/// the mesh, e.g. surfacemesh_to_skeleton).
+class EigenContractionContext{
+private:
+    typedef ContractionSolver::Permutation Permutation;
+
+    ContractionSolver* solver;  ///< the backend
+    QString solverName;         ///< name of the backend
+    SurfaceMeshModel* mesh;     ///< mesh the analysis refers to
+    int topologyVersion;        ///< connectivity version the analysis refers to
+    int nrows;                  ///< size of the analyzed matrix
+    int nnz;                    ///< non-zeros of the analyzed matrix
+    std::vector<int> order;     ///< vertex handles in elimination order (empty: backend orders)
+    int nhandles;               ///< size of the vertex containers when order was computed
+    int handlesVersion;         ///< handle numbering the order refers to
+    double amdfill;             ///< nnz(L)/nnz(AtA) of the last fresh ordering
+
+public:
+    bool incremental;           ///< reuse the ordering across topology changes
+    double maxtouched;          ///< max fraction of touched vertices for the ordering to be reused
+    double maxfill;             ///< max fill growth w.r.t. a fresh ordering
+    ContractionWorkspace workspace; ///< packed per-vertex state (rows of the system)
+
+    EigenContractionContext(QString solverName=SOLVER_LDLT) : solver(NULL), mesh(NULL), topologyVersion(-1), nrows(-1), nnz(-1), nhandles(0), handlesVersion(-1), amdfill(0), incremental(false), maxtouched(0.1), maxfill(1.25){
+        setSolver(solverName);
+    }
+    ~EigenContractionContext(){ delete solver; }
+
+    /// Switches backend (a new analysis is needed if it changed)
+    void setSolver(QString name){
+        if(solver && name==solverName) return;
+        ContractionSolver* newsolver = ContractionSolver::create(name);
+        delete solver;
+        solver = newsolver;
+        solverName = name;
+        mesh = NULL;
+        order.clear();
+    }
+
+    /// Numeric factorization, preceded by the symbolic one only if the pattern could have changed
+    void factorize(SurfaceMeshModel* mesh, const SparseMatrix<double>& AtA){
+        int version = mesh->property("topologyVersion").toInt();
+        bool reuse = (this->mesh==mesh) && (topologyVersion==version) && (nrows==AtA.rows()) && (nnz==AtA.nonZeros());
+        if(reuse){
+            solver->factorize(AtA);
+            return;
+        }
+
+        Permutation P;
+        bool reordered = incremental && (this->mesh==mesh) && !order.empty() && updateOrdering(mesh,P);
+        solver->analyzePattern(AtA,P);
+        solver->factorize(AtA);
+
+        int fill = solver->factorNonZeros();
+        if(reordered){
+            double ratio = double(fill)/AtA.nonZeros();
+            logme(QString().sprintf("[Incremental]\tfill %.2f (fresh ordering %.2f)",ratio,amdfill));
+            if(ratio > maxfill*amdfill){
+                logme("[Incremental]\tfill grew too much, recomputing the ordering");
+                P = Permutation();
+                solver->analyzePattern(AtA,P);
+                solver->factorize(AtA);
+                fill = solver->factorNonZeros();
+                reordered = false;
+            }
+        }
+        if(!reordered && fill>=0)
+            amdfill = double(fill)/AtA.nonZeros();
+        storeOrdering(mesh,P);
+
+        this->mesh = mesh;
+        topologyVersion = version;
+        nrows = AtA.rows();
+        nnz = AtA.nonZeros();
+    }
+
+    /// X holds the previous positions on input
+    void solve(const MatrixXd& B, MatrixXd& X){ solver->solve(B,X); }
+
+private:
+    /// Remembers the elimination order by vertex handle, so that it survives re-indexing
+    void storeOrdering(SurfaceMeshModel* mesh, const Permutation& P){
+        order.clear();
+        nhandles = mesh->vertices_size();
+        handlesVersion = mesh->property("handlesVersion").toInt();
+        if(P.size()==0) return;
+        order.resize(P.size());
+        for(int r=0; r<workspace.rows(); r++)
+            order[ P.indices()(r) ] = workspace.handle[r];
+    }
+
+    /// Patches the previous order into P, false if too many vertices were touched
+    bool updateOrdering(SurfaceMeshModel* mesh, Permutation& P){
+        const ContractionWorkspace& ws = workspace;
+
+        /// The handles of the order are meaningless once the mesh was compacted
+        bool stale = (mesh->property("handlesVersion").toInt()!=handlesVersion) || ((int)mesh->vertices_size()<nhandles);
+        for(int k=0; k<(int)order.size() && !stale; k++)
+            stale = (order[k]>=(int)mesh->vertices_size());
+        if(stale){
+            logme("[Incremental]\tvertex handles were renumbered, recomputing the ordering");
+            order.clear();
+            return false;
+        }
+
+        /// Rank of the surviving vertices in the old order
+        std::vector<int> rank(mesh->vertices_size(),-1);
+        int ndeleted = 0;
+        for(int k=0; k<(int)order.size(); k++){
+            if(mesh->is_deleted(Surface_mesh::Vertex(order[k]))) ndeleted++;
+            else rank[order[k]] = k;
+        }
+
+        /// Survivors keep their place, new vertices go right after their last eliminated neighbor
+        std::vector< std::pair<int,int> > keys; ///< (key,row)
+        keys.reserve(ws.rows());
+        int nadded = 0;
+        for(int r=0; r<ws.rows(); r++){
+            int key;
+            if(ws.handle[r]<nhandles){
+                key = 2*rank[ws.handle[r]];
+            } else {
+                nadded++;
+                int last = -1;
+                for(int k=ws.ring_offset[r]; k<ws.ring_offset[r+1]; k++){
+                    int w = ws.handle[ws.ring_row[k]];
+                    if(w<nhandles) last = qMax(last, rank[w]);
+                }
+                key = (last<0) ? 2*(int)order.size()+1 : 2*last+1;
+            }
+            keys.push_back(std::make_pair(key,r));
+        }
+
+        int ntouched = ndeleted+nadded;
+        logme(QString().sprintf("[Incremental]\t%d deleted, %d added, %d/%d kept their place",ndeleted,nadded,(int)order.size()-ndeleted,(int)mesh->n_vertices()));
+        if(ntouched > maxtouched*mesh->n_vertices())
+            return false;
+
+        std::sort(keys.begin(),keys.end());
+        P.resize(keys.size());
+        for(int k=0; k<(int)keys.size(); k++)
+            P.indices()(keys[k].second) = k;
+        return true;
+    }
+};
+
 class EigenContractionHelper : public SurfaceMesh::SurfaceMeshHelper{
 private:
     int nrows, ncols;
 
-    typedef Surface_mesh::Vertex_property<uint>  IndexVertexProperty;
-
-    IndexVertexProperty vindex;   
     SparseMatrix<double> LHS;
     MatrixXd RHS;
-    MatrixXd X;
+    EigenContractionContext localcontext;
+    EigenContractionContext& context; ///< kept across iterations (unless none was given)
+    ContractionWorkspace& ws;         ///< rows of the system
 
 public:
-    EigenContractionHelper(SurfaceMeshModel* mesh) : SurfaceMeshHelper(mesh){}
+    EigenContractionHelper(SurfaceMeshModel* mesh, EigenContractionContext* context=NULL) : SurfaceMeshHelper(mesh), context(context ? *context : localcontext), ws(this->context.workspace){}
     void evolve(ScalarVertexProperty omega_H, ScalarVertexProperty omega_L, ScalarVertexProperty omega_P, Vector3VertexProperty poles){
         ScalarHalfedgeProperty hweight = CotangentLaplacianHelper(mesh).computeCotangentEdgeWeights("h:weight");
         
-        updateVertexIndexes();
-#if 0
-        createLHS(hweight,omega_L,omega_H);
-        createRHS(omega_H,points);
+        ws.repack(mesh);
+        ws.gather(hweight,omega_L,omega_H,omega_P,poles,points);
+#ifdef USE_TALL_LHS
+        createLHS();
+        createRHS();
 #else
-        createLHS(hweight,omega_L,omega_H,omega_P);
-        createRHS(omega_H,points,omega_P,poles);        
+        createNormalEquations();
 #endif
         solveByFactorization(VPOINT);
     }
-    void updateVertexIndexes();
-    void createLHS(ScalarHalfedgeProperty hweight, ScalarVertexProperty omega_L, ScalarVertexProperty omega_H);    
-    void createLHS(ScalarHalfedgeProperty hweight, ScalarVertexProperty omega_L, ScalarVertexProperty omega_H, ScalarVertexProperty omega_P);
-    void createRHS(ScalarVertexProperty omega_H, Vector3VertexProperty vinitial);
-    void createRHS(ScalarVertexProperty omega_H, Vector3VertexProperty vinitial, ScalarVertexProperty omega_P, Vector3VertexProperty poles);
+    void createNormalEquations();
+    void createLHS(bool withPoles=true);
+    void createRHS(bool withPoles=true);
     
     void solveByFactorization(std::string vsolution);
     void solve_linear_least_square(SparseMatrix<double> & A, MatrixXd & B, MatrixXd & X);
+    void solve_normal_equations(SparseMatrix<double> & AtA, MatrixXd & AtB, MatrixXd & X);
 };
 
-void EigenContractionHelper::updateVertexIndexes(){
-    /// Create indexes for mesh vertices
-    vindex = mesh->vertex_property<uint>("v:index",0);
-    uint curr_vidx = 0;
-    foreach(Vertex v, mesh->vertices())
-        vindex[v] = curr_vidx++;
-}
-
-void EigenContractionHelper::createLHS(ScalarHalfedgeProperty hweight, ScalarVertexProperty omega_L, ScalarVertexProperty omega_H){
-    nrows = 2*mesh->n_vertices();
-    ncols = mesh->n_vertices();
+/// Tall system [L;W_H;W_P] (the pole rows only if withPoles)
+void EigenContractionHelper::createLHS(bool withPoles){
+    ncols = ws.rows();
+    nrows = (withPoles ? 3 : 2)*ncols;
 
     /// Allocate memory
     LHS.resize(nrows,ncols);
     RHS = MatrixXd::Zero(nrows, 3);
-    X = MatrixXd::Zero(ncols, 3);
 
     /// Assemble sparse matrix with eigen triplets        
     typedef Triplet<double> TripletDouble;
     std::vector< TripletDouble > triplets;
-    triplets.reserve(ncols * 6);
+    triplets.reserve(ncols*9); /// 7 entries/row on laplacian, 1 on each constraint matrix
     
-    /// Fill laplacian matrix (off diagonal)
-    foreach(Halfedge h, mesh->halfedges()){
-        Vertex v0 = mesh->from_vertex(h);
-        Vertex v1 = mesh->to_vertex(h);
-        triplets.push_back(TripletDouble(vindex[v0], vindex[v1], hweight[h]*omega_L[v0]));
-    }
-    /// Fill laplacian matrix (diagonal)
-    foreach(Vertex v, mesh->vertices()){
+    /// Fill laplacian matrix
+    for(int r=0; r<ncols; r++){
         double sum = 0;
-        foreach(Halfedge h, mesh->onering_hedges(v))
-            sum += hweight[h];
-        triplets.push_back(TripletDouble(vindex[v],vindex[v], -sum));
+        for(int k=ws.ring_offset[r]; k<ws.ring_offset[r+1]; k++){
+            triplets.push_back(TripletDouble(r, ws.ring_row[k], ws.ring_weight[k]*ws.omega_L[r]));
+            sum += ws.ring_weight[k];
+        }
+        triplets.push_back(TripletDouble(r, r, -sum));
     }
     
-    /// Set bottom half of matrix (constraints)
-    foreach(Vertex v, mesh->vertices())
-        triplets.push_back(TripletDouble(vindex[v] + ncols, vindex[v], omega_H[v]));
+    /// Set bottom part of matrix (constraints)
+    for(int r=0; r<ncols; r++)
+        triplets.push_back(TripletDouble(r + ncols, r, ws.omega_H[r]));
+    if(withPoles)
+        for(int r=0; r<ncols; r++)
+            triplets.push_back(TripletDouble(r + 2*ncols, r, ws.omega_P[r]));
     
     LHS.setFromTriplets(triplets.begin(), triplets.end());
 }
 
-void EigenContractionHelper::createLHS(ScalarHalfedgeProperty hweight, ScalarVertexProperty omega_L, ScalarVertexProperty omega_H, ScalarVertexProperty omega_P){
-    nrows = 3*mesh->n_vertices();
-    ncols = mesh->n_vertices();
+/// Assembles AtA and AtB of the least squares system [L;W_H;W_P]X = [0;W_H*V;W_P*P] without ever
+/// forming A. Row i of the laplacian only touches the one-ring of i, so it contributes the outer
+/// product of its (valence+1) entries to AtA; the constraints are diagonal. Only the upper
+/// triangle of AtA is stored (the solver is told so) and entries are kept even when their value
+/// is zero, so that the sparsity pattern only depends on the connectivity.
+void EigenContractionHelper::createNormalEquations(){
+    nrows = ws.rows();
+    ncols = ws.rows();
 
     /// Allocate memory
-    LHS.resize(nrows,ncols);
-    RHS = MatrixXd::Zero(nrows, 3);
-    X = MatrixXd::Zero(ncols, 3);
+    LHS.resize(ncols,ncols);
+    RHS.resize(ncols, 3);
 
-    /// Assemble sparse matrix with eigen triplets        
     typedef Triplet<double> TripletDouble;
     std::vector< TripletDouble > triplets;
-    triplets.reserve(ncols*9); /// 7 entries/row on laplacian, 1 on each constraint matrix
-    
-    /// Fill laplacian matrix (off diagonal)
-    foreach(Halfedge h, mesh->halfedges()){
-        Vertex v0 = mesh->from_vertex(h);
-        Vertex v1 = mesh->to_vertex(h);
-        triplets.push_back(TripletDouble(vindex[v0], vindex[v1], hweight[h]*omega_L[v0]));
-    }
-    /// Fill laplacian matrix (diagonal)
-    foreach(Vertex v, mesh->vertices()){
+    triplets.reserve(ncols*29); /// (6+1)*(6+2)/2 entries per laplacian row, 1 on the diagonal
+
+    /// Sparse laplacian row: diagonal (unscaled by omega_L) followed by the one-ring
+    std::vector<int>    cols;
+    std::vector<double> vals;
+    for(int r=0; r<ncols; r++){
+        cols.clear();
+        vals.clear();
         double sum = 0;
-        foreach(Halfedge h, mesh->onering_hedges(v))
-            sum += hweight[h];
-        triplets.push_back(TripletDouble(vindex[v],vindex[v], -sum));
+        for(int k=ws.ring_offset[r]; k<ws.ring_offset[r+1]; k++){
+            cols.push_back(ws.ring_row[k]);
+            vals.push_back(ws.ring_weight[k]*ws.omega_L[r]);
+            sum += ws.ring_weight[k];
+        }
+        cols.push_back(r);
+        vals.push_back(-sum);
+
+        /// Outer product of the row with itself (upper triangle)
+        for(uint a=0; a<cols.size(); a++)
+            for(uint b=a; b<cols.size(); b++)
+                triplets.push_back(TripletDouble(qMin(cols[a],cols[b]), qMax(cols[a],cols[b]), vals[a]*vals[b]));
     }
-    
-    /// Set bottom half of matrix (constraints)
-    foreach(Vertex v, mesh->vertices())
-        triplets.push_back(TripletDouble(vindex[v] + ncols, vindex[v], omega_H[v]));
-    /// Set bottom half of matrix (constraints)
-    foreach(Vertex v, mesh->vertices())
-        triplets.push_back(TripletDouble(vindex[v] + 2*ncols, vindex[v], omega_P[v]));
-    
-    
-    LHS.setFromTriplets(triplets.begin(), triplets.end());
-}
 
-/// Retrieve & fill RHS (top half is zeros)
-void EigenContractionHelper::createRHS(ScalarVertexProperty omega_H, Vector3VertexProperty vinitial){
-    /// Mesh => constraint vectors
-    // TIMER timer.start();
-    {
-        foreach(Vertex v, mesh->vertices()){
-            Vector3 u = omega_H[v] * vinitial[v];
-            RHS.row(ncols + vindex[v]) = Vector3d(u.x(), u.y(), u.z());
-        }
+    /// Positional and pole constraints
+    const MatrixXd& X = ws.current();
+    for(int r=0; r<ncols; r++){
+        double wH = ws.omega_H[r]*ws.omega_H[r];
+        double wP = ws.omega_P[r]*ws.omega_P[r];
+        triplets.push_back(TripletDouble(r, r, wH+wP));
+        RHS.row(r) = wH*X.row(r) + wP*ws.poles.row(r);
     }
-    // TIMER qDebug() << "Build RHS vector: " << timer.elapsed() << "ms";
+
+    LHS.setFromTriplets(triplets.begin(), triplets.end());
 }
 
-void EigenContractionHelper::createRHS(ScalarVertexProperty omega_H, Vector3VertexProperty vinitial, ScalarVertexProperty omega_P, Vector3VertexProperty poles){
+/// Retrieve & fill RHS (top part is zeros)
+void EigenContractionHelper::createRHS(bool withPoles){
     /// Mesh => constraint vectors
-    // TIMER timer.start();
-    {
-        foreach(Vertex v, mesh->vertices()){
-            Vector3 u = omega_H[v] * vinitial[v];
-            RHS.row(ncols + vindex[v]) = Vector3d(u.x(), u.y(), u.z());
-        }
-    }
-    /// Mesh => constraint vectors
-    {
-        foreach(Vertex v, mesh->vertices()){
-            Vector3 u = omega_P[v] * poles[v];
-            RHS.row(2*ncols + vindex[v]) = Vector3d(u.x(), u.y(), u.z());
-        }
-    }
-    // TIMER qDebug() << "Build RHS vector: " << timer.elapsed() << "ms";
+    const MatrixXd& X = ws.current();
+    for(int r=0; r<ncols; r++)
+        RHS.row(ncols + r) = ws.omega_H[r] * X.row(r);
+    if(withPoles)
+        for(int r=0; r<ncols; r++)
+            RHS.row(2*ncols + r) = ws.omega_P[r] * ws.poles.row(r);
 }
 
 void EigenContractionHelper::solveByFactorization(std::string vsolution){
-    /// Factorize & Solve
-    // TIMER timer.start();
+    /// Factorize & Solve, the current positions are the initial guess of iterative solvers
+    MatrixXd& X = ws.next();
+    X = ws.current();
     {
+#ifdef USE_TALL_LHS
         solve_linear_least_square(LHS, RHS, X);
+#else
+        solve_normal_equations(LHS, RHS, X);
+#endif
     }
-    // TIMER qDebug() << "Factor & Solve: " << timer.elapsed() << "ms";
     
 	if (!std::isfinite(X.norm())){
 		throw StarlabException("Problem with linear least square solution.");
@@ -174,31 +315,25 @@ void EigenContractionHelper::solveByFactorization(std::string vsolution){
 	}
 
     /// Store solution in mesh property
-    // TIMER timer.start();
-    {
-        Vector3VertexProperty _vsolution = getVector3VertexProperty(vsolution);
-        foreach(Vertex v, mesh->vertices()){
-            Vector3d p = X.row(vindex[v]);
-            _vsolution[v] = Vector3(p[0], p[1], p[2]);
-        }
-    }
+    ws.swap();
+    ws.scatter(getVector3VertexProperty(vsolution));
 }
 
 void EigenContractionHelper::solve_linear_least_square(SparseMatrix<double> & A, MatrixXd & B, MatrixXd & X){
+    SparseMatrix<double> At  = A.transpose();
+    SparseMatrix<double> AtA = At * A;
+    MatrixXd AtB = At * B;
+    solve_normal_equations(AtA, AtB, X);
+}
+
+void EigenContractionHelper::solve_normal_equations(SparseMatrix<double> & AtA, MatrixXd & AtB, MatrixXd & X){
     /// Factorize the matrix
     // tic(" CholFactor");
-        SparseMatrix<double> At  = A.transpose();
-        SparseMatrix<double> AtA = At * A;
-        //typedef CholmodDecomposition< SparseMatrix<double> > Solver;
-        typedef SimplicialLDLT< SparseMatrix<double> > Solver;
-        Solver solver;
-        solver.compute(AtA);
+        context.factorize(mesh, AtA);
     // toc();
     
-    /// 3x Solves
+    /// Blocked solve of the 3 coordinates
     // tic(" Back-Substitution");
-		X.col(0) = solver.solve(At * B.col(0));
-		X.col(1) = solver.solve(At * B.col(1));
-		X.col(2) = solver.solve(At * B.col(2));
+        context.solve(AtB, X);
     // toc();
 }
@@ -0,0 +1,51 @@
+#pragma once
+#include <Eigen/Core>
+
+/// Cosines of the angles of a block of triangles, used by TopologyJanitor to find the faces to
+/// split. The corners q0, q1, q2 of up to SIZE faces are gathered in SoA layout (one column per
+/// coordinate) so that the law of cosines is evaluated by eigen's vectorized array kernels.
+/// Handle is whatever the caller needs to scatter the results back (a halfedge of the face).
+template <class Scalar, class Handle>
+struct FaceCosinesBlock{
+    enum{ SIZE=256 };
+    typedef Eigen::Array<Scalar,Eigen::Dynamic,1,0,SIZE,1> ArrayXs;
+
+    Eigen::Array<Scalar,SIZE,9> q;        ///< q0, q1, q2 by coordinate
+    Eigen::Array<Scalar,SIZE,3> cosines;  ///< angles opposite to the edges q0q1, q1q2, q2q0
+    Handle handles[SIZE];
+    int n;
+
+    FaceCosinesBlock() : n(0){}
+    bool full() const { return n==SIZE; }
+
+    template <class Point>
+    void add(Handle handle, const Point& p0, const Point& p1, const Point& p2){
+        handles[n] = handle;
+        for(int k=0; k<3; k++){
+            q(n,k)   = p0[k];
+            q(n,3+k) = p1[k];
+            q(n,6+k) = p2[k];
+        }
+        n++;
+    }
+
+    /// Fills cosines.head(n). A degenerate triangle will never undergo a split (but rather a
+    /// collapse...): if one of its edges is shorter than short_edge, its cosines are set to 2,
+    /// i.e. its angles are smaller than any threshold
+    void compute(Scalar short_edge){
+        if(n==0) return;
+
+        /// Squared edge lengths (a: q0q1, b: q1q2, c: q2q0)
+        ArrayXs a2 = (q.col(3)-q.col(0)).head(n).square() + (q.col(4)-q.col(1)).head(n).square() + (q.col(5)-q.col(2)).head(n).square();
+        ArrayXs b2 = (q.col(6)-q.col(3)).head(n).square() + (q.col(7)-q.col(4)).head(n).square() + (q.col(8)-q.col(5)).head(n).square();
+        ArrayXs c2 = (q.col(0)-q.col(6)).head(n).square() + (q.col(1)-q.col(7)).head(n).square() + (q.col(2)-q.col(8)).head(n).square();
+
+        Scalar short2 = short_edge*short_edge;
+        Eigen::Array<bool,Eigen::Dynamic,1,0,SIZE,1> degenerate = (a2<short2) || (b2<short2) || (c2<short2);
+
+        /// Opposite angles (from law of cosines)
+        cosines.col(0).head(n) = degenerate.select(2.0, ((-a2 +b2 +c2)/(2*(b2*c2).sqrt())).max(-1.0).min(1.0));
+        cosines.col(1).head(n) = degenerate.select(2.0, (( a2 -b2 +c2)/(2*(a2*c2).sqrt())).max(-1.0).min(1.0));
+        cosines.col(2).head(n) = degenerate.select(2.0, (( a2 +b2 -c2)/(2*(a2*b2).sqrt())).max(-1.0).min(1.0));
+    }
+};
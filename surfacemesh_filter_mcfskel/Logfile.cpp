@@ -5,15 +5,29 @@
 #include <QElapsedTimer>
 #include <QDebug>
 #include <QTime>
+#include <QThreadStorage>
+#if !defined(_WIN32)
+#include <sys/resource.h>
+#endif
 
 /// Static variable have local scope!!
 /// i.e. only visible by methods in this file
-static QFile logfile;
-static bool inprogress = false;
-static QString agent = "agent";
-static QElapsedTimer timer;
+/// Every thread has its own log, so that meshes can be processed concurrently
+struct LogState{
+    QFile logfile;
+    bool inprogress;
+    QString agent;
+    QElapsedTimer timer;
+    LogState() : inprogress(false), agent("agent"){}
+};
+static QThreadStorage<LogState*> states;
+static LogState& state(){
+    if(!states.hasLocalData()) states.setLocalData(new LogState());
+    return *states.localData();
+}
 
 void tictocreset(QString filename){
+    QFile& logfile = state().logfile;
     logfile.setFileName(filename);
     if(logfile.exists()) logfile.remove();
     logfile.open(QFile::WriteOnly);
@@ -21,6 +35,7 @@ void tictocreset(QString filename){
 }
 
 void logme(QString message){
+    QFile& logfile = state().logfile;
     logfile.open(QFile::Append);
     logfile.write(qPrintable(message));
     logfile.write("\n");
@@ -28,21 +43,38 @@ void logme(QString message){
 }
 
 void toc(bool enabled){
-    Q_ASSERT(logfile.exists());
-    int time = timer.elapsed();
+    LogState& s = state();
+    Q_ASSERT(s.logfile.exists());
+    int time = s.timer.elapsed();
     if(enabled){
-        logfile.open(QFile::Append);
+        s.logfile.open(QFile::Append);
         QString message;
-        message.sprintf("[%s]\t%dms\n",qPrintable(agent),time);
-        logfile.write(qPrintable(message));
-        logfile.close();
+        message.sprintf("[%s]\t%dms\n",qPrintable(s.agent),time);
+        s.logfile.write(qPrintable(message));
+        s.logfile.close();
     }
-    inprogress = false;
+    s.inprogress = false;
 }
 
 void tic(QString curragent){
-    Q_ASSERT(logfile.exists());
-    if(inprogress) toc(true);
-    agent = curragent;
-    timer.start();
+    LogState& s = state();
+    Q_ASSERT(s.logfile.exists());
+    if(s.inprogress) toc(true);
+    s.agent = curragent;
+    s.timer.start();
+}
+
+/// Peak resident set size of the process in KB (0 if not available)
+long peakmemory(){
+#if defined(_WIN32)
+    return 0;
+#else
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    #if defined(__APPLE__)
+        return usage.ru_maxrss/1024; ///< bytes on OSX
+    #else
+        return usage.ru_maxrss;
+    #endif
+#endif
 }
@@ -4,3 +4,4 @@ void tictocreset(QString filename);
 void toc(bool enabled=true);
 void tic(QString curragent);
 void logme(QString message);
+long peakmemory();
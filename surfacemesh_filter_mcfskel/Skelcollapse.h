@@ -7,17 +7,7 @@
 #include "SurfaceMeshPlugins.h"
 #include "StarlabDrawArea.h"
 #include "SurfaceMeshHelper.h"
-#include "Logfile.h"
-
-typedef QList<Surface_mesh::Vertex> VertexList;
-typedef Surface_mesh::Vertex_property<VertexList> VertexListVertexProperty;
-
-#ifdef USE_MATLAB
-    const bool use_matlab = true;
-#else
-    const bool use_matlab = false;
-#endif
-
+#include "SkelcollapseHelper.h"
 
 class Skelcollapse : public SurfaceMeshFilterPlugin{
     Q_OBJECT
@@ -30,34 +20,26 @@ public:
     virtual QKeySequence shortcut(){ return QKeySequence(Qt::CTRL + Qt::Key_L); }
     
 private:
-    /// @{ algorithm parameters
-        Scalar omega_L_0;
-        Scalar omega_H_0;
-        Scalar omega_P_0;
-        Scalar edgelength_TH;
-        Scalar zero_TH;        
-    /// @} 
-        
-    /// @{ algorithm internal data
-        VertexListVertexProperty corrs;            
-        Vector3VertexProperty points;
-        Vector3VertexProperty poles;
-        ScalarVertexProperty  omega_H;
-        ScalarVertexProperty  omega_L;
-        ScalarVertexProperty  omega_P;
-        BoolVertexProperty    vissplit;
-        BoolVertexProperty    visfixed;
-        bool                  isInitialized;
-    /// @}
-        
+    SkelcollapseHelper* skelcollapse; ///< kept across invocations (one per iteration)
+
 public:
+    Skelcollapse() : skelcollapse(NULL){}
+    ~Skelcollapse();
+
     void initParameters(RichParameterSet* parameters){
-        Scalar scale = 0.002*mesh()->bbox().diagonal().norm();
-        parameters->addParam(new RichFloat("omega_L_0",1.0f));
-        parameters->addParam(new RichFloat("omega_H_0",use_matlab?20.0f:0.1f));
-        parameters->addParam(new RichFloat("omega_P_0",use_matlab?40.0f:0.2f));
-        parameters->addParam(new RichFloat("edgelength_TH",scale));
-        parameters->addParam(new RichFloat("zero_TH",1e-7f));
+        SkelcollapseHelper defaults(mesh());
+        parameters->addParam(new RichFloat("omega_L_0",defaults.omega_L_0));
+        parameters->addParam(new RichFloat("omega_H_0",defaults.omega_H_0));
+        parameters->addParam(new RichFloat("omega_P_0",defaults.omega_P_0));
+        parameters->addParam(new RichFloat("edgelength_TH",defaults.edgelength_TH));
+        parameters->addParam(new RichFloat("zero_TH",defaults.zero_TH));
+        if(!use_matlab){
+            parameters->addParam(new RichStringSet("solver",ContractionSolver::names(),"Solver","Sparse solver used by the contraction step"));
+            parameters->addParam(new RichBool("incremental",defaults.incremental,"Incremental","Reuse the elimination order when the topology changed only slightly"));
+        }
+        parameters->addParam(new RichBool("batch",false,"Run to convergence","Iterate until convergence instead of performing a single iteration"));
+        parameters->addParam(new RichInt("max_iterations",defaults.maxIterations,"Max iterations","Maximum number of iterations of a run to convergence"));
+        parameters->addParam(new RichFloat("area_ratio_TH",defaults.areaRatio_TH,"Area ratio","Converged when the surface area drops below this fraction of the initial one"));
         
         /// Add a transparent copy of the model, must be done only when the parameter window
         /// is open (a.k.a. on first iteration)
@@ -80,34 +62,12 @@ public:
 			}
 		}
 
-        { /// Retrieve parameters
-            omega_L_0     = pars->getFloat("omega_L_0"); 
-            omega_H_0     = pars->getFloat("omega_H_0");
-            omega_P_0     = pars->getFloat("omega_P_0");
-            edgelength_TH = pars->getFloat("edgelength_TH");
-            zero_TH       = pars->getFloat("zero_TH");
-        }
-        
-        { /// Retrieve properties
-            SurfaceMeshHelper helper(mesh());
-            points        = helper.getVector3VertexProperty(VPOINT);
-            poles         = helper.getVector3VertexProperty("v:pole");
-            omega_H       = mesh()->vertex_property<Scalar>("v:omega_H",omega_H_0);
-            omega_L       = mesh()->vertex_property<Scalar>("v:omega_L",omega_L_0);
-            omega_P       = mesh()->vertex_property<Scalar>("v:omega_P",omega_P_0);
-            vissplit      = mesh()->vertex_property<bool>("v:issplit",false);
-            visfixed      = mesh()->vertex_property<bool>("v:isfixed",false);
-            isInitialized = mesh()->property("isInitialized").toBool();
-            corrs         = mesh()->vertex_property<VertexList>("v:corrs");
-        }        
-        
-        if(!isInitialized){
+        if(!mesh()->property("isInitialized").toBool()){
             /// Setup LOG file
             tictocreset("log.txt");
 
-            /// Every vertex initially corresponds to itself
-            foreach(Vertex v, mesh()->vertices())
-                corrs[v].push_back(v);
+            /// Nothing can be reused from a previous model
+            resetHelper();
         
             /// Change name/path of the model
             QFileInfo fi(mesh()->path);
@@ -115,30 +75,41 @@ public:
             QString currpath = fi.dir().path();
             mesh()->path = currpath+"/"+basename+"_ckel.off";
         }
-        
-        /// Run a single iteration (for now...)
-        algorithm_iteration();
-        
-        /// Tell the model this is not its first iteration
-        mesh()->setProperty("isInitialized",true);
-    }
+        if(!skelcollapse || skelcollapse->model()!=mesh()){
+            resetHelper();
+            skelcollapse = new SkelcollapseHelper(mesh());
+        }
 
-    void algorithm_iteration(){  
-        logme("----------- ITERATION ----------");
-        tic("Geometry Contraction"); contractGeometry();   toc();
-        tic("Constraints Update");   updateConstraints();  toc();
-        tic("Update Topology");      updateTopology();     toc();        
-        tic("Detect Degeneracies");  detectDegeneracies(); toc();
+        { /// Retrieve parameters
+            skelcollapse->omega_L_0     = pars->getFloat("omega_L_0"); 
+            skelcollapse->omega_H_0     = pars->getFloat("omega_H_0");
+            skelcollapse->omega_P_0     = pars->getFloat("omega_P_0");
+            skelcollapse->edgelength_TH = pars->getFloat("edgelength_TH");
+            skelcollapse->zero_TH       = pars->getFloat("zero_TH");
+            skelcollapse->maxIterations = pars->getInt("max_iterations");
+            skelcollapse->areaRatio_TH  = pars->getFloat("area_ratio_TH");
+            if(!use_matlab){
+                skelcollapse->solverName  = pars->getString("solver");
+                skelcollapse->incremental = pars->getBool("incremental");
+            }
+        }
+        skelcollapse->setup();
+
+        if(pars->getBool("batch"))
+            skelcollapse->algorithm_converge();
+        else
+            skelcollapse->algorithm_iteration();
 
         /// Highlight fixed vertices
+        Vector3VertexProperty points = mesh()->get_vertex_property<Vector3>(VPOINT);
+        BoolVertexProperty visfixed = mesh()->get_vertex_property<bool>("v:isfixed");
         foreach(Vertex v, mesh()->vertices()){
             if( visfixed[v] )
                 drawArea()->drawPoint(points[v],3,Qt::red);        
         }    
     }
-    
-    void updateConstraints();
-    void contractGeometry();
-    void detectDegeneracies();
-    void updateTopology();
+
+private:
+    /// Drops the helper (and the state it keeps across iterations)
+    void resetHelper();
 };
@@ -0,0 +1,144 @@
+#include "SkelcollapseHelper.h"
+#include "TopologyJanitor.h"
+#include "TopologyJanitor_ClosestPole.h"
+#include "CorrespondenceTracker.h"
+
+#ifdef USE_MATLAB
+    #include "MatlabContractionHelper.h"
+#else
+    #include "EigenContractionHelper.h"
+#endif
+
+SkelcollapseHelper::SkelcollapseHelper(SurfaceMeshModel* mesh) : SurfaceMeshHelper(mesh), context(NULL){
+    omega_L_0     = 1.0;
+    omega_H_0     = use_matlab?20.0:0.1;
+    omega_P_0     = use_matlab?40.0:0.2;
+    edgelength_TH = 0.002*mesh->bbox().diagonal().norm();
+    zero_TH       = 1e-7;
+    solverName    = SOLVER_LDLT;
+    incremental   = true;
+    maxIterations = 500;
+    areaRatio_TH  = 1e-3;
+}
+
+SkelcollapseHelper::~SkelcollapseHelper(){
+#ifndef USE_MATLAB
+    delete context;
+#endif
+}
+
+void SkelcollapseHelper::setup(){
+    poles    = getVector3VertexProperty("v:pole");
+    omega_H  = mesh->vertex_property<Scalar>("v:omega_H",omega_H_0);
+    omega_L  = mesh->vertex_property<Scalar>("v:omega_L",omega_L_0);
+    omega_P  = mesh->vertex_property<Scalar>("v:omega_P",omega_P_0);
+    vissplit = mesh->vertex_property<bool>("v:issplit",false);
+    visfixed = mesh->vertex_property<bool>("v:isfixed",false);
+
+    if(!mesh->property("isInitialized").toBool()){
+        /// Every vertex initially corresponds to itself
+        CorrespondenceTracker corrs(mesh);
+
+        /// Reference for the convergence test
+        mesh->setProperty("initialArea",surfaceArea());
+
+        /// Tell the model this is not its first iteration
+        mesh->setProperty("isInitialized",true);
+    }
+}
+
+void SkelcollapseHelper::algorithm_iteration(){
+    logme("----------- ITERATION ----------");
+    tic("Geometry Contraction"); contractGeometry();   toc();
+    logme(QString().sprintf("[Peak memory]\t%ldKB",peakmemory()));
+    tic("Constraints Update");   updateConstraints();  toc();
+    tic("Update Topology");      updateTopology();     toc();
+    tic("Detect Degeneracies");  detectDegeneracies(); toc();
+}
+
+void SkelcollapseHelper::algorithm_converge(){
+    Scalar area0 = mesh->property("initialArea").toDouble();
+    for(int iteration=1; iteration<=maxIterations; iteration++){
+        algorithm_iteration();
+
+        Scalar ratio = surfaceArea()/area0;
+        Counter nfree = 0;
+        foreach(Vertex v, mesh->vertices())
+            if(!visfixed[v]) nfree++;
+        logme(QString().sprintf("[Batch]\titeration %d, area ratio %g, %d free vertices",iteration,ratio,(int)nfree));
+
+        if(ratio<areaRatio_TH){ logme("[Batch]\tconverged (area ratio)"); return; }
+        if(nfree==0){ logme("[Batch]\tconverged (all vertices fixed)"); return; }
+    }
+    logme(QString().sprintf("[Batch]\tstopped after %d iterations",maxIterations));
+}
+
+Scalar SkelcollapseHelper::surfaceArea(){
+    Scalar area = 0;
+    foreach(Face f, mesh->faces()){
+        Halfedge h = mesh->halfedge(f);
+        Vector3 p0 = points[mesh->from_vertex(h)];
+        Vector3 p1 = points[mesh->to_vertex(h)];
+        Vector3 p2 = points[mesh->to_vertex(mesh->next_halfedge(h))];
+        area += 0.5*cross(p1-p0,p2-p0).norm();
+    }
+    return area;
+}
+
+void SkelcollapseHelper::contractGeometry(){
+#ifdef USE_MATLAB
+    MatlabContractionHelper(mesh).evolve(omega_H,omega_L,omega_P,poles,zero_TH);
+#else
+    if(!context) context = new EigenContractionContext(solverName);
+    context->setSolver(solverName);
+    context->incremental = incremental;
+    EigenContractionHelper(mesh,context).evolve(omega_H,omega_L,omega_P,poles);
+#endif
+}
+
+void SkelcollapseHelper::updateConstraints(){
+    foreach(Vertex v, mesh->vertices()){
+        /// Leave fixed points really alone
+        if(visfixed[v]){
+            omega_L[v] = 0;
+            omega_H[v] = 1.0/zero_TH;
+            omega_P[v] = 0;
+            continue;
+        }
+
+        omega_L[v] = omega_L_0;
+        omega_H[v] = omega_H_0;
+        omega_P[v] = omega_P_0;
+
+        /// Ficticious vertices are simply relaxed
+        if(vissplit[v]){
+            omega_L[v] = omega_L_0;
+            omega_H[v] = omega_H_0;
+            omega_P[v] = 0;
+        }
+    }
+}
+
+void SkelcollapseHelper::detectDegeneracies(){
+    Scalar elength_fixed = edgelength_TH/10.0;
+    foreach(Vertex v, mesh->vertices()){
+        /// previously fixed remain so
+        if(visfixed[v]) continue;
+
+        bool willbefixed = false;
+        Counter badcounter=0;
+        foreach(Halfedge h, mesh->onering_hedges(v)){
+            Scalar elength = mesh->edge_length(mesh->edge(h));
+            if(elength<elength_fixed && !mesh->is_collapse_ok(h))
+                badcounter++;
+        }
+        willbefixed = (badcounter>=2);
+        visfixed[v] = willbefixed;
+    }
+}
+
+void SkelcollapseHelper::updateTopology(){
+    // QString message = TopologyJanitor(mesh).cleanup(zero_TH,edgelength_TH,110);
+    QString message = TopologyJanitor_ClosestPole(mesh).cleanup(zero_TH,edgelength_TH,110);
+    qDebug() << message;
+}
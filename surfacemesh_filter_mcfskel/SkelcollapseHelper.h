@@ -0,0 +1,61 @@
+#pragma once
+#include "SurfaceMeshHelper.h"
+#include "Logfile.h"
+#include "ContractionSolver.h"
+
+#ifdef USE_MATLAB
+    const bool use_matlab = true;
+#else
+    const bool use_matlab = false;
+#endif
+
+class EigenContractionContext;
+
+/// The (medially guided) MCF iterations on a mesh, independent of the Starlab GUI so that it
+/// can be driven both by the Skelcollapse filter and by the command line batch skeletonizer.
+/// The mesh must already carry the "v:pole" property (see voromat).
+class SkelcollapseHelper : public SurfaceMeshHelper{
+public:
+    /// @{ algorithm parameters
+        Scalar omega_L_0;
+        Scalar omega_H_0;
+        Scalar omega_P_0;
+        Scalar edgelength_TH;
+        Scalar zero_TH;
+        QString solverName;
+        bool incremental;
+        int maxIterations;     ///< cap on the iterations of converge()
+        Scalar areaRatio_TH;   ///< converged when area/initial area drops below this
+    /// @}
+
+private:
+    /// @{ algorithm internal data
+        Vector3VertexProperty poles;
+        ScalarVertexProperty  omega_H;
+        ScalarVertexProperty  omega_L;
+        ScalarVertexProperty  omega_P;
+        BoolVertexProperty    vissplit;
+        BoolVertexProperty    visfixed;
+        EigenContractionContext* context; ///< solver state kept across iterations
+    /// @}
+
+public:
+    /// Parameters are set to the defaults of the filter (edgelength_TH relative to the bbox)
+    SkelcollapseHelper(SurfaceMeshModel* mesh);
+    ~SkelcollapseHelper();
+
+    /// Retrieves the properties, creating and initializing them on the first call on a mesh
+    void setup();
+    void algorithm_iteration();
+    /// Iterates until the surface has (almost) no area left, every vertex is fixed, or maxIterations
+    void algorithm_converge();
+
+    SurfaceMeshModel* model(){ return mesh; }
+    Scalar surfaceArea();
+
+private:
+    void updateConstraints();
+    void contractGeometry();
+    void detectDegeneracies();
+    void updateTopology();
+};
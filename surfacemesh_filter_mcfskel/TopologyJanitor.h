@@ -1,5 +1,8 @@
 #pragma once
+#include <deque>
 #include "SurfaceMeshHelper.h"
+#include "FaceCosines.h"
+#include "CorrespondenceTracker.h"
 
 #ifdef WIN32
 #define NAN std::numeric_limits<Scalar>::signaling_NaN()
@@ -8,116 +11,184 @@ namespace std{  bool isnan(double x){ return _isnan(x); }
 #endif
 
 class TopologyJanitor : public virtual SurfaceMeshHelper{
+protected:
+    BoolVertexProperty visfixed;
+    BoolVertexProperty vissplit;
+    CorrespondenceTracker corrs;
+
 public:
-    TopologyJanitor(SurfaceMeshModel* mesh) : SurfaceMeshHelper(mesh){}
+    TopologyJanitor(SurfaceMeshModel* mesh) : SurfaceMeshHelper(mesh), corrs(mesh){
+        visfixed = mesh->get_vertex_property<bool>("v:isfixed");
+        vissplit = mesh->vertex_property<bool>("v:issplit",false);
+    }
     QString cleanup(Scalar short_edge, Scalar edgelength_TH, Scalar alpha){
         Size nv_prev = mesh->n_vertices();
         Counter numCollapses = iteratively_coolapseShortEdges(edgelength_TH);
         Counter numSplits = iteratively_splitFlatTriangles(short_edge,alpha);
+        
+        /// Connectivity changed, cached symbolic factorizations are invalid
+        if(numCollapses+numSplits>0)
+            mesh->setProperty("topologyVersion", mesh->property("topologyVersion").toInt()+1);
+        
         QString retval;
         retval.sprintf("Topology update: #V %d ==> %d [ #Collapses: %d, #Splits: %d]",nv_prev,mesh->n_vertices(),numCollapses, numSplits);
         return retval;
     }
 protected:
-    virtual ScalarHalfedgeProperty cacheAngles(Scalar short_edge){
-        /// Store halfedge opposite angles
-        ScalarHalfedgeProperty halpha = mesh->halfedge_property<Scalar>("h:alpha",0);
+    /// Stores the cosine of the angle opposite to each halfedge. Angles are never needed: acos is
+    /// decreasing, so thresholds and comparisons between angles are done on their cosines (in
+    /// reverse). Faces are processed in blocks (FaceCosinesBlock), vectorized by eigen.
+    virtual ScalarHalfedgeProperty cacheCosines(Scalar short_edge){
+        ScalarHalfedgeProperty hcosalpha = mesh->halfedge_property<Scalar>("h:cosalpha",2);
+        CosinesBlock block;
         foreach(Face f,mesh->faces()){
             Halfedge h_a = mesh->halfedge(f);
             Halfedge h_b = mesh->next_halfedge(h_a);
+            block.add(h_a, points[mesh->from_vertex(h_a)], points[mesh->to_vertex(h_a)], points[mesh->to_vertex(h_b)]);
+            if(block.full())
+                flushCosines(block,short_edge,hcosalpha);
+        }
+        flushCosines(block,short_edge,hcosalpha);
+        return hcosalpha;
+    }
+
+private:
+    typedef FaceCosinesBlock<Scalar,Halfedge> CosinesBlock;
+
+    void flushCosines(CosinesBlock& block, Scalar short_edge, ScalarHalfedgeProperty hcosalpha){
+        int n = block.n;
+        if(n==0) return;
+        block.compute(short_edge);
+
+        /// Scatter to the halfedges
+        for(int i=0; i<n; i++){
+            Halfedge h_a = block.handles[i];
+            Halfedge h_b = mesh->next_halfedge(h_a);
             Halfedge h_c = mesh->next_halfedge(h_b);
-            Edge e_a = mesh->edge(h_a);
-            Edge e_b = mesh->edge(h_b);
-            Edge e_c = mesh->edge(h_c);
-    
-            /// Edge lengths
-            Scalar a = mesh->edge_length(e_a), a2=a*a;
-            Scalar b = mesh->edge_length(e_b), b2=b*b;
-            Scalar c = mesh->edge_length(e_c), c2=c*c;
-                
-            /// A degenerate triangle will never undergo a split (but rather a collapse...)        
-            if( a<short_edge || b<short_edge || c<short_edge ){
-                halpha[h_a] = -1;
-                halpha[h_b] = -1;
-                halpha[h_c] = -1;
-            } else {
-                /// Opposite angles (from law of cosines)
-                halpha[h_a] = acos( qBound(-1.0, (-a2 +b2 +c2)/(2*  b*c), +1.0) );
-                halpha[h_b] = acos( qBound(-1.0, (+a2 -b2 +c2)/(2*a  *c), +1.0) );
-                halpha[h_c] = acos( qBound(-1.0, (+a2 +b2 -c2)/(2*a*b  ), +1.0) );
-            }
-            
-    #if 0
-            if(!(fabs( (halpha[h_a]+halpha[h_b]+halpha[h_c])-3.1415 )<1e-3) ){
-                qDebug() << "Detected bad angles: " << halpha[h_a] << halpha[h_b] << halpha[h_c];
-                qDebug() << "Edge lengths: " << a << b << c;
-                // qDebug() << (+a2 +b2 -c2)/(2*a*b  );
-                
-                Vector3 p0 = points[ mesh->to_vertex(h_a) ];
-                Vector3 p1 = points[ mesh->to_vertex(h_b) ];
-                Vector3 p2 = points[ mesh->to_vertex(h_c) ];
-                drawArea->drawPoint(p0,2);
-                drawArea->drawPoint(p1,2);
-                drawArea->drawPoint(p2,2);            
-            }
-    #endif
+            hcosalpha[h_a] = block.cosines(i,0);
+            hcosalpha[h_b] = block.cosines(i,1);
+            hcosalpha[h_c] = block.cosines(i,2);
         }
-        
-        return halpha;
+        block.n = 0;
+    }
+
+protected:
+    /// Should the collapse of h (from_vertex into to_vertex) take place?
+    virtual bool canCollapse(Halfedge h, Scalar short_edge){
+        Vertex v0 = mesh->from_vertex(h);
+        Vertex v1 = mesh->to_vertex(h);
+        /// Don't collapse fixed edges...!!
+        if(visfixed[v0] && visfixed[v1]) return false;
+        return mesh->edge_length(mesh->edge(h))<short_edge && mesh->is_collapse_ok(h);
+    }
+    /// Collapses h, the survivor is its to_vertex
+    virtual void collapseEdge(Halfedge h){
+        Vertex v0 = mesh->from_vertex(h);
+        Vertex v1 = mesh->to_vertex(h);
+        points[v1] = (points[v0]+points[v1])/2.0f;
+        corrs.merge(v0,v1);
+        mesh->collapse(h);
     }
 
-    virtual Counter collapser(Scalar short_edge){
-        Vector3VertexProperty points = mesh->get_vertex_property<Point>("v:point");
-        BoolVertexProperty visfixed = mesh->get_vertex_property<bool>("v:isfixed");
+    /// Worklist collapser: the short edges are queued once, then a collapse only changes the
+    /// edges around the surviving vertex (their length) and around its one-ring (the link
+    /// condition of is_collapse_ok), so only those are re-examined. When the queue runs dry a
+    /// sweep over all edges, as the original iterative collapser did, re-queues anything still
+    /// collapsible, so the result is a fixed point as with repeated sweeps.
+    Counter collapser(Scalar short_edge){
+        std::deque<Edge> queue;
+        std::vector<bool> inqueue(mesh->edges_size(),false);
+        foreach(Edge e,mesh->edges())
+            enqueue(queue,inqueue,e,short_edge);
+
         Counter count=0;
-        foreach(Edge e,mesh->edges()){
-            Halfedge h = mesh->halfedge(e,0);
-            Vertex v0 = mesh->from_vertex(h);
-            Vertex v1 = mesh->to_vertex(h);
-            /// Don't collapse fixed edges...!!
-            if(visfixed[v0] && visfixed[v1]) continue;
-            if(mesh->edge_length(e)<short_edge){
-                if(!mesh->is_deleted(h) && mesh->is_collapse_ok(h)){
-                    points[v1] = (points[v0]+points[v1])/2.0f;
-                    mesh->collapse(h);
-                    count++;
+        while(!queue.empty()){
+            while(!queue.empty()){
+                Edge e = queue.front();
+                queue.pop_front();
+                inqueue[e.idx()] = false;
+                if(mesh->is_deleted(e)) continue;
+
+                Halfedge h = mesh->halfedge(e,0);
+                if(!canCollapse(h,short_edge)) continue;
+                Vertex v1 = mesh->to_vertex(h);
+                collapseEdge(h);
+                count++;
+
+                /// Re-examine the edges of the survivor and of its one-ring vertices
+                foreach(Halfedge hv, mesh->onering_hedges(v1)){
+                    enqueue(queue,inqueue,mesh->edge(hv),short_edge);
+                    foreach(Halfedge hw, mesh->onering_hedges(mesh->to_vertex(hv)))
+                        enqueue(queue,inqueue,mesh->edge(hw),short_edge);
                 }
             }
+
+            /// Verification sweep
+            foreach(Edge e,mesh->edges())
+                if(canCollapse(mesh->halfedge(e,0),short_edge))
+                    enqueue(queue,inqueue,e,short_edge);
         }
         return count;
-    }    
-    virtual Counter splitter(Scalar short_edge, Scalar TH_ALPHA /*110*/){
-        Vector3VertexProperty points = mesh->get_vertex_property<Point>("v:point");
-        
+    }
+    void enqueue(std::deque<Edge>& queue, std::vector<bool>& inqueue, Edge e, Scalar short_edge){
+        if(inqueue[e.idx()] || mesh->edge_length(e)>=short_edge) return;
+        queue.push_back(e);
+        inqueue[e.idx()] = true;
+    }
+
+    /// Can e be split? (the angle test is done by the splitter)
+    virtual bool canSplit(Edge e){
+        /// Don't collapse fixed!!
+        return !(visfixed[mesh->vertex(e,0)] && visfixed[mesh->vertex(e,1)]);
+    }
+    /// Splits e at distance t from vertex(e,0), returns the new vertex
+    virtual Vertex splitEdge(Edge e, Scalar t){
+        Point p0 = points[mesh->vertex(e,0)];
+        Point p1 = points[mesh->vertex(e,1)];
+        Vector3 newpos = p0 + t*(p1-p0).normalized();
+        Vertex vnew = mesh->split(e,newpos);
+        vissplit[vnew] = true;
+        return vnew;
+    }
+
+    /// Worklist splitter: the cosines are computed once and all the edges opposite to two
+    /// obtuse enough angles are queued. A split only changes the faces around the new vertex,
+    /// so only their cosines are updated and only their edges are re-queued.
+    Counter splitter(Scalar short_edge, Scalar TH_ALPHA /*110*/){
         /// Keep track / decide which to split    
         TH_ALPHA *= (3.14/180);
+        Scalar cosTH_ALPHA = cos(TH_ALPHA);
     
-        /// Compute halpha
-        ScalarHalfedgeProperty halpha = cacheAngles(short_edge);        
+        /// Compute hcosalpha
+        ScalarHalfedgeProperty hcosalpha = cacheCosines(short_edge);        
         
-        /// Splitting section
-        BoolVertexProperty visfixed = mesh->get_vertex_property<bool>("v:isfixed");
-        Scalar numsplits=0;
-        BoolVertexProperty vissplit = mesh->vertex_property<bool>("v:issplit",false);
+        std::deque<Edge> queue;
+        std::vector<bool> inqueue(mesh->edges_size(),false);
         foreach(Edge e, mesh->edges()){
-            Vertex v0 = mesh->vertex(e,0);
-            Vertex v1 = mesh->vertex(e,1);
-            
-            /// Don't collapse fixed!!
-            if(visfixed[v0] && visfixed[v1]) continue;
+            queue.push_back(e);
+            inqueue[e.idx()] = true;
+        }
+
+        /// Splitting section
+        Counter numsplits=0;
+        while(!queue.empty()){
+            Edge e = queue.front();
+            queue.pop_front();
+            inqueue[e.idx()] = false;
+            if(mesh->is_deleted(e) || !canSplit(e)) continue;
             
             Halfedge h0 = mesh->halfedge(e,0);
             Halfedge h1 = mesh->halfedge(e,1);
     
-            /// Should a split take place?
-            Scalar alpha_0 = halpha[ h0 ];
-            Scalar alpha_1 = halpha[ h1 ];
-            if(alpha_0<TH_ALPHA || alpha_1<TH_ALPHA) continue;
+            /// Should a split take place? (alpha<TH_ALPHA)
+            Scalar cosalpha_0 = hcosalpha[ h0 ];
+            Scalar cosalpha_1 = hcosalpha[ h1 ];
+            if(cosalpha_0>cosTH_ALPHA || cosalpha_1>cosTH_ALPHA) continue;
             
-            /// Which side should I split?
+            /// Which side should I split? (the largest angle)
             Vertex w0 = mesh->to_vertex( mesh->next_halfedge(h0) );
             Vertex w1 = mesh->to_vertex( mesh->next_halfedge(h1) );
-            Vertex wsplitside = (alpha_0>alpha_1) ? w0 : w1;
+            Vertex wsplitside = (cosalpha_0<cosalpha_1) ? w0 : w1;
             
             /// Project side vertex on edge
             Point p0 = points[mesh->vertex(e,0)];
@@ -125,40 +196,41 @@ protected:
             Vector3 projector = (p1-p0).normalized();
             Vector3 projectee = points[wsplitside]-p0;
             Scalar t = dot(projector, projectee);
-            
             Q_ASSERT(!std::isnan(t));
-            Vector3 newpos = p0 + t*projector;
             
             /// Perform the split at the desired location
-            Vertex vnew = mesh->split(e,newpos);
-            vissplit[vnew] = true;
+            Vertex vnew = splitEdge(e,t);
             numsplits++;
+
+            /// Update the faces around the new vertex, re-queue their edges
+            inqueue.resize(mesh->edges_size(),false);
+            CosinesBlock block;
+            foreach(Halfedge h, mesh->onering_hedges(vnew)){
+                if(mesh->is_boundary(h)) continue;
+                Halfedge h_a = h;
+                Halfedge h_b = mesh->next_halfedge(h_a);
+                Halfedge h_c = mesh->next_halfedge(h_b);
+                block.add(h_a, points[mesh->from_vertex(h_a)], points[mesh->to_vertex(h_a)], points[mesh->to_vertex(h_b)]);
+                if(block.full())
+                    flushCosines(block,short_edge,hcosalpha);
+                Halfedge hedges[3] = {h_a, h_b, h_c};
+                for(int i=0; i<3; i++){
+                    Edge ei = mesh->edge(hedges[i]);
+                    if(!inqueue[ei.idx()]){ queue.push_back(ei); inqueue[ei.idx()] = true; }
+                }
+            }
+            flushCosines(block,short_edge,hcosalpha);
         }
         return numsplits;
     }
 
 protected:    
     Counter iteratively_splitFlatTriangles(Scalar short_edge /*1e-10*/, Scalar TH_ALPHA /*110*/){
-        Counter new_splits=0;
-        Counter tot_splits=0;
-        do{
-            new_splits = splitter(short_edge,TH_ALPHA);
-            tot_splits += new_splits;
-            // qDebug() << "new splits: " << new_collapses;
-        } while(new_splits>0);
-        return tot_splits;
+        /// The worklist runs until no flat triangle is left
+        return splitter(short_edge,TH_ALPHA);
     }
     Counter iteratively_coolapseShortEdges(Scalar edgelength_TH){
-        /// This could be done more efficiently, by keeping 
-        /// track of possible rings where new collapses took
-        /// place... but I am lazy...
-        Counter new_collapses=0;
-        Counter tot_collapses=0;
-        do{
-            new_collapses = collapser(edgelength_TH);
-            tot_collapses += new_collapses;
-            // qDebug() << "new collapses: " << new_collapses;
-        } while(new_collapses>0);
-        return tot_collapses;
+        /// The worklist runs until no short edge can be collapsed
+        return collapser(edgelength_TH);
     }
 };
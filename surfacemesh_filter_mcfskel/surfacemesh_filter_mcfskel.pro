@@ -10,20 +10,48 @@ CONFIG(matlab){
     STARLAB_EXTERNAL += matlab 
 }
 
+# Comment to build without the CHOLMOD supernodal backend
+CONFIG += cholmod
+CONFIG(cholmod){
+    DEFINES += USE_CHOLMOD
+}
+
+# Uncomment to solve via the tall 3n x n least squares matrix (A^T*A formed by eigen)
+# rather than by assembling the normal equations directly (useful for benchmarking)
+# CONFIG += tall_lhs
+CONFIG(tall_lhs){
+    DEFINES += USE_TALL_LHS
+}
+
+# OpenMP (cotangent weights)
+unix:!macx{
+    QMAKE_CXXFLAGS += -fopenmp
+    QMAKE_LFLAGS += -fopenmp
+}
+win32{
+    QMAKE_CXXFLAGS += /openmp
+}
+
 DEPENDPATH += $$PWD
 
 HEADERS += \
     Skelcollapse.h \
+    SkelcollapseHelper.h \
     TopologyJanitor.h \
     TopologyJanitor_ClosestPole.h \
+    FaceCosines.h \
     MatlabContractionHelper.h \
     EigenContractionHelper.h \
+    ContractionSolver.h \
+    ContractionWorkspace.h \
+    CorrespondenceTracker.h \
     CotangentLaplacianHelper.h \
     MeanValueLaplacianHelper.h \
     Logfile.h
 
 SOURCES += \  
     Skelcollapse.cpp \
+    SkelcollapseHelper.cpp \
     Logfile.cpp
 
 
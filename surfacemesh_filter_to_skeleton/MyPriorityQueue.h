@@ -1,68 +1,94 @@
 #pragma once
-#include <set>
+#include <vector>
+#include <utility>
 
 #include "CurveskelHelper.h"
 namespace CurveskelTypes{
 
+/// Min priority queue of edges keyed by length (ties broken by index), as an array based binary
+/// heap with back indexes (as MaxHeap in MyHeaps.h): the position of every edge in the heap is
+/// known, so membership is O(1) and a key can be moved in either direction in O(log n).
 class MyPriorityQueue{
-public:
-    class EdgeCompareFunctor{
-    public:
-        ScalarEdgeProperty elengths;
-        
-        EdgeCompareFunctor(CurveskelModel* skel){
-            elengths = skel->edge_property<Scalar>("e:length");
+private:
+    typedef std::pair<Scalar,int> Entry;  ///< (length, edge index)
+    std::vector<Entry> heap;              ///< heap[0] is the shortest
+    std::vector<int> pos;                 ///< edge index => position in heap, -1 if not in it
+
+    static int parent(int i){ return (i-1)>>1; }
+    static int left(int i){ return (i<<1)+1; }
+
+    void place(int i, const Entry& entry){
+        heap[i] = entry;
+        pos[entry.second] = i;
+    }
+    void siftUp(int i){
+        Entry entry = heap[i];
+        while(i>0 && entry < heap[parent(i)]){
+            place(i, heap[parent(i)]);
+            i = parent(i);
         }
-        
-        bool operator() (const Edge& lhs, const Edge& rhs) const{
-            Scalar p0 = elengths[lhs];
-            Scalar p1 = elengths[rhs];
-            return (p0 == p1) ? (lhs.idx()<rhs.idx()) : (p0 < p1);
+        place(i, entry);
+    }
+    void siftDown(int i){
+        Entry entry = heap[i];
+        int n = heap.size();
+        while(left(i)<n){
+            int child = left(i);
+            if(child+1<n && heap[child+1]<heap[child]) child++;
+            if(!(heap[child]<entry)) break;
+            place(i, heap[child]);
+            i = child;
         }
-    };   
-    EdgeCompareFunctor compareFunctor;
-    std::set<Edge, EdgeCompareFunctor> set;
-        
-    MyPriorityQueue(CurveskelModel* skel) : compareFunctor(skel), set(compareFunctor){}
-    
-    void insert(Edge edge, Scalar length){
-        compareFunctor.elengths[edge] = length;
-        set.insert(edge);
+        place(i, entry);
     }
-    
-    bool update(Edge edge, Scalar /*length*/){
-        // remove & reinsert
-        //qDebug() << "updating: " << edge.idx();
 
-		// erase the edge
-        int nerased = set.erase(edge);
-
-        if( nerased != 1 ){
-            qDebug() << "I was supposed to erase one element, but I erased: " << nerased; 
-			return false;  
-        }
+public:
+    MyPriorityQueue(CurveskelModel* skel){
+        heap.reserve(skel->n_edges());
+        pos.assign(skel->edges_size(), -1);
+    }
 
-		// re-insert it
-        set.insert(edge);
+    void insert(Edge edge, Scalar length){
+        if(edge.idx() >= (int)pos.size()) pos.resize(edge.idx()+1, -1);
+        if(pos[edge.idx()] >= 0){ update(edge, length); return; }
+        heap.push_back(Entry(length, edge.idx()));
+        pos[edge.idx()] = heap.size()-1;
+        siftUp(heap.size()-1);
+    }
 
-		return true;
+    /// Changes the length of an edge in the queue (false if it is not in it)
+    bool update(Edge edge, Scalar length){
+        if(!has(edge)){
+            qDebug() << "Updating an edge which is not in the queue: " << edge.idx();
+            return false;
+        }
+        int i = pos[edge.idx()];
+        Entry old = heap[i];
+        heap[i].first = length;
+        if(heap[i] < old) siftUp(i);
+        else siftDown(i);
+        return true;
     }
-    
-    bool empty(){ 
-        return set.empty(); 
+
+    bool empty(){
+        return heap.empty();
     }
-    
+
     Edge pop(){
-        Edge e = *(set.begin());
-        //qDebug() << "popping: " << e.idx() << "[" << compareFunctor.elengths[e] << "]";
-        set.erase(e);
-        compareFunctor.elengths[e] = -1.0;
+        Edge e(heap[0].second);
+        pos[e.idx()] = -1;
+        Entry last = heap.back();
+        heap.pop_back();
+        if(!heap.empty()){
+            place(0, last);
+            siftDown(0);
+        }
         return e;
     }
 
 	bool has(Edge edge)
 	{
-		return set.find(edge) != set.end();
+		return edge.idx() < (int)pos.size() && pos[edge.idx()] >= 0;
 	}
 };
 
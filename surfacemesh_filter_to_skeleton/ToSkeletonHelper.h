@@ -0,0 +1,190 @@
+#pragma once
+#include "SurfaceMeshModel.h"
+#include "CurveskelModel.h"
+#include "CurveskelHelper.h"
+#include "MyPriorityQueue.h"
+#include "CorrespondenceTracker.h"
+
+/// Converts a (contracted) SurfaceMeshModel into a CurveskelModel by collapsing its edges,
+/// shortest first, until no face is left. Used by the filter and by the batch skeletonizer.
+///
+/// Every node of the skeleton also gets the vertices of the original surface it stands for
+/// (CurveskelModel::samples): the collapses are recorded in a linear merge log, resolved at the
+/// end, and composed with the correspondences kept by the contraction (see CorrespondenceTracker;
+/// without them a vertex of the input mesh stands for itself).
+class ToSkeletonHelper{
+private:
+    SurfaceMeshModel* model;
+
+public:
+    ToSkeletonHelper(SurfaceMeshModel* model) : model(model){}
+
+    /// The caller takes ownership of the returned model
+    CurveskelTypes::CurveskelModel* convert(){
+        /// Original vertices of each live vertex of the mesh, before the handles are compacted
+        std::vector<int> corrs_offset, corrs_samples;
+        bool hascorrs = false;
+        if(model->get_vertex_property<int>("v:corrs-parent")){
+            CorrespondenceTracker(model).materialize(corrs_offset, corrs_samples);
+            hascorrs = true;
+        }
+
+        /// The forest refers to uncompacted handles: it is dropped (its content is in the lists).
+        /// Solver state kept by mcfskel on this mesh refers to them too ("handlesVersion")
+        model->garbage_collection();
+        model->setProperty("handlesVersion", model->property("handlesVersion").toInt()+1);
+        if(hascorrs) CorrespondenceTracker::remove(model);
+        Surface_mesh::Vertex_property<int> vgroup = model->get_vertex_property<int>("v:corrs-group");
+        CurveskelTypes::CurveskelModel* skel = new CurveskelTypes::CurveskelModel("","skeleton");
+
+        /// 0) modify WindedgeMesh.h if you need anything below
+        /// 1) read through triangles and fill in the wingedge data structure
+
+        // vertices
+        Surface_mesh::Vertex_property<SurfaceMeshModel::Point> points = model->get_vertex_property<SurfaceMeshModel::Point>("v:point");
+        for (Surface_mesh::Vertex_iterator vit = model->vertices_begin(); vit!=model->vertices_end(); ++vit)
+        {
+            SurfaceMeshModel::Point p = points[vit];
+            skel->add_vertex(CurveskelTypes::Vector3(p[0], p[1], p[2]));
+        }
+
+        // faces (triangles), edges are found through the (vertex,vertex) hash from now on
+        std::vector<int> triangles;
+        triangles.reserve(3*model->n_faces());
+        for (Surface_mesh::Face_iterator fit = model->faces_begin(); fit!=model->faces_end(); ++fit)
+        {
+            Surface_mesh::Vertex_around_face_circulator fvit = model->vertices(fit), fvend=fvit;
+            do triangles.push_back(Surface_mesh::Vertex(fvit).idx());
+            while (++fvit != fvend);
+        }
+        skel->use_edge_index();
+        skel->add_triangles(triangles);
+
+        skel->print_stats();
+
+        /// 2) perform sorted edge collapse
+        CurveskelTypes::CurveskelHelper sh(skel);
+        CurveskelTypes::ScalarEdgeProperty elen = sh.computeEdgeLengths();
+
+        // Add to priority queue
+        CurveskelTypes::MyPriorityQueue queue(skel);
+        foreach(CurveskelTypes::Edge edge, skel->edges())
+            queue.insert(edge, elen[edge]);
+
+        // This will be used to position collapsed vertices
+        CurveskelTypes::CurveskelModel::Vertex_property<CurveskelTypes::Point> skel_points = skel->vertex_property<CurveskelTypes::Point>("v:point");
+
+        // (removed,survivor) of every collapse
+        std::vector< std::pair<int,int> > mergelog;
+        mergelog.reserve(model->n_vertices());
+
+        int counter = 0;
+
+        /// Collapse cycle
+        while (!queue.empty()){
+            //qDebug() << "counter: " << counter;
+
+            /// Retrieve shortest edge
+            CurveskelTypes::CurveskelModel::Edge e = queue.pop();
+
+            /// Make sure edge was not already dealt with by previous collapses
+            if(!skel->has_faces(e) || skel->is_deleted(e) || !skel->is_valid(e))
+                continue;
+
+            CurveskelTypes::CurveskelModel::Vertex v1 = skel->vertex(e, 0); // 'v1' will be deleted
+            CurveskelTypes::CurveskelModel::Vertex v2 = skel->vertex(e, 1);
+
+            /// Do collapse
+            skel->collapse(e);
+
+            /// record collapsed vertex
+            mergelog.push_back(std::make_pair(v1.idx(), v2.idx()));
+
+            /// Re-position target vertex to midpoint [look at code after loop]
+            //skel_points[v2] = (skel_points[v1] + skel_points[v2]) / 2;
+
+            /// Update length of edges incident to remaining vertex
+            CurveskelTypes::CurveskelModel::Edge_around_vertex eit (skel, v2);
+
+            while(!eit.end())
+            {
+                CurveskelTypes::CurveskelModel::Edge edge = eit;
+
+                double newLength = skel->edge_length(edge);
+
+                // If edge still in queue, update its position
+                if(queue.has(edge))
+                    queue.update(edge, newLength);
+
+                ++eit;
+            }
+
+            //qDebug() << "size " << queue.set.size();
+            counter++;
+        }
+
+        /// Node each vertex ended in: a survivor is its own, a removed vertex the one of its
+        /// survivor (known when the log is walked backwards, as the survivor was removed later)
+        int nverts = model->n_vertices();
+        std::vector<int> owner(nverts);
+        for(int vi = 0; vi < nverts; vi++) owner[vi] = vi;
+        for(int k = (int)mergelog.size()-1; k >= 0; k--)
+            owner[mergelog[k].first] = owner[mergelog[k].second];
+
+        /// Nodes are numbered as after the garbage collection (live vertices in order)
+        std::vector<int> nodeof(nverts,-1);
+        int nnodes = 0;
+        for(int vi = 0; vi < nverts; vi++)
+            if(!skel->is_deleted(CurveskelTypes::Vertex(vi))) nodeof[vi] = nnodes++;
+
+        /// Mesh vertices of each node (counting sort)
+        std::vector<int> node_offset(nnodes+1,0), node_verts(nverts);
+        for(int vi = 0; vi < nverts; vi++) node_offset[nodeof[owner[vi]]+1]++;
+        for(int n = 0; n < nnodes; n++) node_offset[n+1] += node_offset[n];
+        std::vector<int> next(node_offset.begin(), node_offset.end()-1);
+        for(int vi = 0; vi < nverts; vi++) node_verts[ next[nodeof[owner[vi]]]++ ] = vi;
+
+        /// Nodes are moved to the centroid of their vertices
+        for(int vi = 0; vi < nverts; vi++)
+        {
+            if(nodeof[vi] < 0) continue;
+            int n = nodeof[vi];
+            CurveskelTypes::Vector3 center(0,0,0);
+            for(int k = node_offset[n]; k < node_offset[n+1]; k++)
+            {
+                SurfaceMeshModel::Point p = points[SurfaceMeshModel::Vertex(node_verts[k])];
+                center += CurveskelTypes::Vector3(p[0], p[1], p[2]);
+            }
+            center /= node_offset[n+1] - node_offset[n];
+            skel_points[CurveskelTypes::Vertex(vi)] = center;
+        }
+
+        /// Original surface vertices of each node
+        std::vector<int> samples_offset(nnodes+1,0), samples;
+        for(int n = 0; n < nnodes; n++){
+            int count = 0;
+            for(int k = node_offset[n]; k < node_offset[n+1]; k++){
+                int g = hascorrs ? vgroup[Surface_mesh::Vertex(node_verts[k])] : -1;
+                count += hascorrs ? corrs_offset[g+1]-corrs_offset[g] : 1;
+            }
+            samples_offset[n+1] = samples_offset[n] + count;
+        }
+        samples.reserve(samples_offset[nnodes]);
+        for(int n = 0; n < nnodes; n++){
+            for(int k = node_offset[n]; k < node_offset[n+1]; k++){
+                if(!hascorrs){ samples.push_back(node_verts[k]); continue; }
+                int g = vgroup[Surface_mesh::Vertex(node_verts[k])];
+                samples.insert(samples.end(), corrs_samples.begin()+corrs_offset[g], corrs_samples.begin()+corrs_offset[g+1]);
+            }
+        }
+
+        if(vgroup) model->remove_vertex_property(vgroup);
+
+        /// now, delete the items that have been marked to be deleted
+        skel->garbage_collection();
+        skel->samples_offset.swap(samples_offset);
+        skel->samples.swap(samples);
+        skel->print_stats();
+        return skel;
+    }
+};
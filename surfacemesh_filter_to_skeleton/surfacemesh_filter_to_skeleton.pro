@@ -3,6 +3,9 @@ include($$[SURFACEMESH])
 include($$[CURVESKEL])
 StarlabTemplate(plugin)
 
-HEADERS += surfacemesh_filter_to_skeleton.h
+# Correspondences kept by the contraction
+INCLUDEPATH += $$PWD/../surfacemesh_filter_mcfskel
+
+HEADERS += surfacemesh_filter_to_skeleton.h ToSkeletonHelper.h
 SOURCES += surfacemesh_filter_to_skeleton.cpp
  
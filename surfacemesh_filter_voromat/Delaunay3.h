@@ -0,0 +1,394 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <cmath>
+#include <cfloat>
+#include <cstdint>
+
+/// 3D delaunay tetrahedralization, just what is needed for the voronoi poles.
+///
+/// Points are inserted incrementally (Bowyer-Watson) in BRIO order: rounds of growing size
+/// drawn at random, sorted along a Z-order curve within a round, so that the walk locating the
+/// next point is short and the cache stays warm. The predicates are plain floating point: the
+/// points are joggled (as with qhull's QJ) to break cospherical configurations, and a cavity is
+/// grown until it is star shaped w.r.t. the inserted point so the mesh stays valid. The
+/// circumcenters and the poles, independent per tetrahedron / per sample, are computed in
+/// parallel.
+///
+/// If the predicates still go wrong, the faces of a cavity do not pair up: the insertion stops
+/// there and nBroken() is non-zero, the tetrahedralization must then not be used.
+///
+/// The bounding tetrahedron is finite: near flat parts of the convex hull it can take the place
+/// of the finite tetrahedra, and a hull sample may be left with none of them (nOrphans()). The
+/// poles of such samples are unknown, the tetrahedralization must not be used for them either.
+class Delaunay3{
+public:
+    /// A tetrahedron: n[i] is the one across the face opposite to v[i] (-1 if none). Dead
+    /// tetrahedra (removed by a cavity) have v[0]==-1.
+    struct Tet{
+        int v[4];
+        int n[4];
+        double c[3];  ///< circumcenter (joggled points)
+        double r2;    ///< squared circumradius
+    };
+
+private:
+    int npoints;                ///< input points, followed by the 4 of the bounding tetrahedron
+    const double* xyz;          ///< input coordinates (not copied, must outlive the object)
+    std::vector<double> pts;    ///< joggled coordinates
+    std::vector<Tet> tets;
+    std::vector<int> freetets;
+    int last;                   ///< where the next walk starts
+    int nbroken;                ///< faces of a cavity left without their neighbor
+    int norphans;               ///< samples without a finite tetrahedron
+
+    /// @{ cavity workspace (stamps avoid clearing per insertion)
+    std::vector<int> incavity;
+    int stamp;
+    std::vector<int> cavity, stack;
+    struct Face{ int tet, i, outside, j; };
+    std::vector<Face> boundary;
+    struct Link{ int a, b, k, j; bool operator<(const Link& o) const{ return a<o.a || (a==o.a && b<o.b); } };
+    std::vector<Link> links;
+    std::vector<Tet> created;
+    std::vector<int> ids;
+    /// @}
+
+public:
+    /// @{ results, finite tetrahedra only (no vertex of the bounding tetrahedron)
+    std::vector<int> tetra;      ///< 4 point indices per tetrahedron, positively oriented
+    std::vector<double> center;  ///< 3 coordinates per tetrahedron, of the input (not joggled) points
+    /// @}
+
+    Delaunay3(const double* xyz, int n, double joggle = 1e-9, unsigned seed = 0) : npoints(n), xyz(xyz), last(0), nbroken(0), norphans(0), stamp(0){
+        std::mt19937 rng(seed);
+
+        /// Bounding box
+        double lo[3] = { DBL_MAX, DBL_MAX, DBL_MAX}, hi[3] = {-DBL_MAX,-DBL_MAX,-DBL_MAX};
+        for(int i = 0; i < n; i++)
+            for(int k = 0; k < 3; k++){
+                lo[k] = std::min(lo[k], xyz[3*i+k]);
+                hi[k] = std::max(hi[k], xyz[3*i+k]);
+            }
+        double extent = std::max(hi[0]-lo[0], std::max(hi[1]-lo[1], hi[2]-lo[2]));
+        if(extent <= 0) extent = 1;
+
+        /// Joggled copy, followed by a (positively oriented) bounding tetrahedron
+        pts.resize(3*(n+4));
+        std::uniform_real_distribution<double> jog(-joggle*extent, joggle*extent);
+        for(int i = 0; i < 3*n; i++) pts[i] = xyz[i] + jog(rng);
+        double mid[3] = { (lo[0]+hi[0])/2, (lo[1]+hi[1])/2, (lo[2]+hi[2])/2 };
+        const double S = 100*extent;
+        const double corner[4][3] = { {S,S,S}, {-S,-S,S}, {-S,S,-S}, {S,-S,-S} };
+        for(int c = 0; c < 4; c++)
+            for(int k = 0; k < 3; k++)
+                pts[3*(n+c)+k] = mid[k] + corner[c][k];
+        Tet t0;
+        for(int i = 0; i < 4; i++){ t0.v[i] = n+i; t0.n[i] = -1; }
+        if(orient(t0.v[0],t0.v[1],t0.v[2],t0.v[3]) < 0) std::swap(t0.v[0],t0.v[1]);
+        circumsphere(t0);
+        tets.push_back(t0);
+
+        /// Insert in BRIO order
+        std::vector<int> order = brio(n, lo, extent, rng);
+        for(int i = 0; i < n && nbroken == 0; i++)
+            insert(order[i], rng);
+
+        finalize();
+    }
+
+    int nTetrahedra() const { return tetra.size()/4; }
+
+    /// Unpaired cavity faces (numerical failure), 0 if the tetrahedralization is valid
+    int nBroken() const { return nbroken; }
+
+    /// Samples incident to no finite tetrahedron, 0 if every sample has candidate poles
+    int nOrphans() const { return norphans; }
+
+    /// For every sample, the finite tetrahedron incident to it whose circumcenter lies in the box
+    /// [lo,hi] and is furthest on the inside (-normal) of the sample, -1 if none. Returns the first
+    /// tetrahedron with a circumcenter in the box (-1 if none).
+    int poles(const double* normals, const double lo[3], const double hi[3], std::vector<int>& poleof) const{
+        int ntets = nTetrahedra();
+        std::vector<char> inbox(ntets);
+        #pragma omp parallel for
+        for(int t = 0; t < ntets; t++){
+            const double* c = &center[3*t];
+            inbox[t] = c[0]>=lo[0] && c[1]>=lo[1] && c[2]>=lo[2] && c[0]<=hi[0] && c[1]<=hi[1] && c[2]<=hi[2];
+        }
+
+        /// Tetrahedra incident to each sample (CSR)
+        std::vector<int> offset(npoints+1, 0);
+        for(int k = 0; k < 4*ntets; k++) offset[tetra[k]+1]++;
+        for(int s = 0; s < npoints; s++) offset[s+1] += offset[s];
+        std::vector<int> incident(4*ntets);
+        std::vector<int> next(offset.begin(), offset.end()-1);
+        for(int k = 0; k < 4*ntets; k++) incident[ next[tetra[k]]++ ] = k/4;
+
+        poleof.assign(npoints, -1);
+        #pragma omp parallel for
+        for(int s = 0; s < npoints; s++){
+            const double* x = &xyz[3*s];
+            const double* nrm = &normals[3*s];
+            double max_neg_t = DBL_MAX;
+            for(int k = offset[s]; k < offset[s+1]; k++){
+                int t = incident[k];
+                if(!inbox[t]) continue;
+                const double* c = &center[3*t];
+                double d = (c[0]-x[0])*nrm[0] + (c[1]-x[1])*nrm[1] + (c[2]-x[2])*nrm[2];
+                if(d < 0 && d < max_neg_t){
+                    max_neg_t = d;
+                    poleof[s] = t;
+                }
+            }
+        }
+
+        for(int t = 0; t < ntets; t++)
+            if(inbox[t]) return t;
+        return -1;
+    }
+
+private:
+    const double* P(int i) const { return &pts[3*i]; }
+
+    double orient(int a, int b, int c, int d) const{
+        const double *pa = P(a), *pb = P(b), *pc = P(c), *pd = P(d);
+        double bx = pb[0]-pa[0], by = pb[1]-pa[1], bz = pb[2]-pa[2];
+        double cx = pc[0]-pa[0], cy = pc[1]-pa[1], cz = pc[2]-pa[2];
+        double dx = pd[0]-pa[0], dy = pd[1]-pa[1], dz = pd[2]-pa[2];
+        return bx*(cy*dz-cz*dy) + by*(cz*dx-cx*dz) + bz*(cx*dy-cy*dx);
+    }
+
+    /// Circumcenter of the 4 points (a is the origin of b,c,d), false if degenerate
+    static bool circumcenter(const double* a, const double* b, const double* c, const double* d, double* out){
+        double bx = b[0]-a[0], by = b[1]-a[1], bz = b[2]-a[2];
+        double cx = c[0]-a[0], cy = c[1]-a[1], cz = c[2]-a[2];
+        double dx = d[0]-a[0], dy = d[1]-a[1], dz = d[2]-a[2];
+        double b2 = bx*bx+by*by+bz*bz, c2 = cx*cx+cy*cy+cz*cz, d2 = dx*dx+dy*dy+dz*dz;
+        double cdx = cy*dz-cz*dy, cdy = cz*dx-cx*dz, cdz = cx*dy-cy*dx;
+        double dbx = dy*bz-dz*by, dby = dz*bx-dx*bz, dbz = dx*by-dy*bx;
+        double bcx = by*cz-bz*cy, bcy = bz*cx-bx*cz, bcz = bx*cy-by*cx;
+        double denom = 2*(bx*cdx + by*cdy + bz*cdz);
+        if(denom == 0) return false;
+        out[0] = a[0] + (b2*cdx + c2*dbx + d2*bcx)/denom;
+        out[1] = a[1] + (b2*cdy + c2*dby + d2*bcy)/denom;
+        out[2] = a[2] + (b2*cdz + c2*dbz + d2*bcz)/denom;
+        return true;
+    }
+
+    void circumsphere(Tet& t) const{
+        const double* a = P(t.v[0]);
+        if(!circumcenter(a, P(t.v[1]), P(t.v[2]), P(t.v[3]), t.c)){
+            /// Flat: never contains anything, the star shape repair takes care of it
+            t.c[0] = t.c[1] = t.c[2] = 0;
+            t.r2 = -1;
+            return;
+        }
+        double x = t.c[0]-a[0], y = t.c[1]-a[1], z = t.c[2]-a[2];
+        t.r2 = x*x+y*y+z*z;
+    }
+
+    bool insphere(const Tet& t, const double* p) const{
+        double x = p[0]-t.c[0], y = p[1]-t.c[1], z = p[2]-t.c[2];
+        return x*x+y*y+z*z < t.r2;
+    }
+
+    /// Biased randomized insertion order: rounds of doubling size (drawn from a random
+    /// permutation), each sorted along a Z-order curve
+    std::vector<int> brio(int n, const double lo[3], double extent, std::mt19937& rng) const{
+        std::vector<uint64_t> key(n);
+        for(int i = 0; i < n; i++){
+            uint64_t q[3];
+            for(int k = 0; k < 3; k++)
+                q[k] = (uint64_t) std::max(0.0, std::min(2097151.0, (pts[3*i+k]-lo[k])/extent*2097151.0));
+            key[i] = spread(q[0]) | spread(q[1])<<1 | spread(q[2])<<2;
+        }
+
+        std::vector<int> order(n);
+        for(int i = 0; i < n; i++) order[i] = i;
+        std::shuffle(order.begin(), order.end(), rng);
+        for(int end = n; end > 0; ){
+            int begin = (end > 64) ? end/2 : 0;
+            std::sort(order.begin()+begin, order.begin()+end, [&key](int a, int b){ return key[a] < key[b]; });
+            end = begin;
+        }
+        return order;
+    }
+
+    static uint64_t spread(uint64_t x){
+        x &= 0x1fffff;
+        x = (x | x << 32) & 0x1f00000000ffffULL;
+        x = (x | x << 16) & 0x1f0000ff0000ffULL;
+        x = (x | x << 8)  & 0x100f00f00f00f00fULL;
+        x = (x | x << 4)  & 0x10c30c30c30c30c3ULL;
+        x = (x | x << 2)  & 0x1249249249249249ULL;
+        return x;
+    }
+
+    /// Walks from the last tetrahedron towards the point, returns the tetrahedron containing it
+    int locate(int p, std::mt19937& rng){
+        int t = last;
+        if(tets[t].v[0] < 0) t = firstAlive();
+        for(size_t steps = 0; steps < 4*tets.size()+16; steps++){
+            const Tet& T = tets[t];
+            int r = rng() & 3;
+            bool moved = false;
+            for(int k = 0; k < 4; k++){
+                int i = (k+r) & 3;
+                if(T.n[i] < 0) continue;
+                int v[4] = { T.v[0], T.v[1], T.v[2], T.v[3] };
+                v[i] = p;
+                if(orient(v[0],v[1],v[2],v[3]) < 0){ t = T.n[i]; moved = true; break; }
+            }
+            if(!moved) return t;
+        }
+        /// The walk did not terminate (numerical cycle): any tetrahedron whose sphere contains p
+        for(int t = 0; t < (int)tets.size(); t++)
+            if(tets[t].v[0] >= 0 && insphere(tets[t], P(p))) return t;
+        return t;
+    }
+
+    int firstAlive() const{
+        for(int t = 0; t < (int)tets.size(); t++)
+            if(tets[t].v[0] >= 0) return t;
+        return 0;
+    }
+
+    void insert(int p, std::mt19937& rng){
+        const double* x = P(p);
+        if(incavity.size() < tets.size()) incavity.resize(2*tets.size(), 0);
+        stamp++;
+
+        /// Tetrahedra whose circumsphere contains the point (connected to the one containing it)
+        int t = locate(p, rng);
+        cavity.clear();
+        stack.clear();
+        stack.push_back(t);
+        incavity[t] = stamp;
+        while(!stack.empty()){
+            int c = stack.back(); stack.pop_back();
+            cavity.push_back(c);
+            for(int i = 0; i < 4; i++){
+                int nb = tets[c].n[i];
+                if(nb < 0 || incavity[nb] == stamp) continue;
+                if(insphere(tets[nb], x)){
+                    incavity[nb] = stamp;
+                    stack.push_back(nb);
+                }
+            }
+        }
+
+        /// Grow the cavity until every boundary face sees the point (star shaped)
+        bool grown = true;
+        while(grown){
+            grown = false;
+            boundary.clear();
+            for(size_t k = 0; k < cavity.size(); k++){
+                int c = cavity[k];
+                const Tet& T = tets[c];
+                for(int i = 0; i < 4; i++){
+                    int nb = T.n[i];
+                    if(nb >= 0 && incavity[nb] == stamp) continue;
+                    int v[4] = { T.v[0], T.v[1], T.v[2], T.v[3] };
+                    v[i] = p;
+                    if(nb >= 0 && orient(v[0],v[1],v[2],v[3]) <= 0){
+                        incavity[nb] = stamp;
+                        cavity.push_back(nb);
+                        grown = true;
+                        continue;
+                    }
+                    Face f = { c, i, nb, -1 };
+                    if(nb >= 0)
+                        for(int j = 0; j < 4; j++)
+                            if(tets[nb].n[j] == c) f.j = j;
+                    boundary.push_back(f);
+                }
+            }
+        }
+
+        /// One new tetrahedron per boundary face: the cavity one with its far vertex moved to p
+        created.resize(boundary.size());
+        for(size_t k = 0; k < boundary.size(); k++){
+            const Face& f = boundary[k];
+            Tet& T = created[k];
+            T = tets[f.tet];
+            T.v[f.i] = p;
+            for(int j = 0; j < 4; j++) T.n[j] = -1;
+            T.n[f.i] = f.outside;
+        }
+
+        /// Slots: the cavity ones first, then the free list, then new ones
+        ids.resize(created.size());
+        for(size_t k = 0; k < created.size(); k++){
+            if(k < cavity.size()) ids[k] = cavity[k];
+            else if(!freetets.empty()){ ids[k] = freetets.back(); freetets.pop_back(); }
+            else { ids[k] = tets.size(); tets.push_back(Tet()); }
+        }
+        for(size_t k = created.size(); k < cavity.size(); k++){
+            tets[cavity[k]].v[0] = -1;
+            freetets.push_back(cavity[k]);
+        }
+
+        /// Faces between new tetrahedra share p and two vertices of the boundary face
+        links.clear();
+        for(size_t k = 0; k < created.size(); k++){
+            const Tet& T = created[k];
+            int i = boundary[k].i;
+            for(int j = 0; j < 4; j++){
+                if(j == i) continue;
+                int a = -1, b = -1;
+                for(int m = 0; m < 4; m++){
+                    if(m == i || m == j) continue;
+                    if(a < 0) a = T.v[m]; else b = T.v[m];
+                }
+                Link l = { std::min(a,b), std::max(a,b), (int)k, j };
+                links.push_back(l);
+            }
+        }
+        std::sort(links.begin(), links.end());
+        for(size_t m = 0; m < links.size(); ){
+            const Link& l0 = links[m];
+            const Link& l1 = links[std::min(m+1, links.size()-1)];
+            if(m+1 == links.size() || l0.a != l1.a || l0.b != l1.b){ nbroken++; m++; continue; } ///< only if numerically broken
+            created[l0.k].n[l0.j] = ids[l1.k];
+            created[l1.k].n[l1.j] = ids[l0.k];
+            m += 2;
+        }
+
+        for(size_t k = 0; k < created.size(); k++){
+            const Face& f = boundary[k];
+            circumsphere(created[k]);
+            tets[ids[k]] = created[k];
+            if(f.outside >= 0) tets[f.outside].n[f.j] = ids[k];
+        }
+        last = ids[0];
+    }
+
+    void finalize(){
+        tetra.clear();
+        for(size_t t = 0; t < tets.size(); t++){
+            const Tet& T = tets[t];
+            if(T.v[0] < 0) continue;
+            if(T.v[0] >= npoints || T.v[1] >= npoints || T.v[2] >= npoints || T.v[3] >= npoints) continue;
+            tetra.insert(tetra.end(), T.v, T.v+4);
+        }
+        std::vector<Tet>().swap(tets);
+        std::vector<int>().swap(freetets);
+        std::vector<int>().swap(incavity);
+
+        std::vector<char> used(npoints, 0);
+        for(size_t k = 0; k < tetra.size(); k++) used[tetra[k]] = 1;
+        norphans = std::count(used.begin(), used.end(), 0);
+
+        int ntets = nTetrahedra();
+        center.resize(3*ntets);
+        #pragma omp parallel for
+        for(int t = 0; t < ntets; t++){
+            const int* v = &tetra[4*t];
+            double* c = &center[3*t];
+            if(!circumcenter(&xyz[3*v[0]], &xyz[3*v[1]], &xyz[3*v[2]], &xyz[3*v[3]], c))
+                c[0] = c[1] = c[2] = DBL_MAX;
+        }
+    }
+};
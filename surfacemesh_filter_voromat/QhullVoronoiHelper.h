@@ -14,9 +14,15 @@
 #include "QhullVertex.h"
 #include "Qhull.h"
 
+#include "Delaunay3.h"
+
 #include <cstdio>   /* for printf() of help message */
 #include <ostream>
 #include <set>
+#include <array>
+#include <algorithm>
+#include <climits>
+#include <cmath>
 
 using std::cerr;
 using std::cin;
@@ -33,16 +39,19 @@ private:
     StarlabDrawArea* drawArea;      /// !NAN
 
 	std::vector< Vector3 > loci;
-	std::vector< std::vector<uint> > cells;
+	std::vector<int> cell_offset;			// Voronoi cells (CSR): the loci of the cell of sample sidx are
+	std::vector<int> cell_loci;				// cell_loci[cell_offset[sidx]...cell_offset[sidx+1]-1]
 
 	std::vector<int> poleof;				// The index of the voronoi pole the vertex refers to
-	std::vector< std::vector<int> > scorr; 	// The index the surface sample to which a pole corresponds to
+	std::vector< std::array<int,4> > scorr;	// The index the surface sample to which a pole corresponds to
 
 	std::vector<double> alpha;
 	std::vector<double> radii;
 
 	int nvertices, nvornoi;
 
+	enum{ MAX_TILES = 32768 };				// Cap on the number of tiles of tiledVoronoiPoles
+
 public:
     VoronoiHelper(SurfaceMeshModel* mesh, StarlabDrawArea* drawArea) : SurfaceMeshHelper(mesh){
         this->drawArea = drawArea;
@@ -54,15 +63,15 @@ public:
     {
 		// Note: we will use entire point cloud indiscriminately 
 		mesh->garbage_collection();
+		mesh->setProperty("handlesVersion", mesh->property("handlesVersion").toInt()+1);
 
         Qhull qhull("", 3, mesh->n_vertices(), &points.data()->x(), "v Qbb");
         //QhullFacetList facets= qhull.facetList();
         //std::cout << facets;
 		
-		// Extract vertices & cell structure
-		cells.resize( mesh->n_vertices() );
-		int i = 0;
-
+		// Extract vertices & the (delaunay) samples of each of them
+		std::vector<int> facet_offset(1,0);
+		std::vector<int> facet_samples;
 		foreach(QhullFacet f, qhull.facetList())
 		{
 			if(f.isUpperDelaunay()) continue;
@@ -75,25 +84,315 @@ public:
 			loci.push_back(p);
 			
 			foreach(QhullVertex v, f.vertices())
-				cells[v.point().id()].push_back(i);
-			
-			i++;
+				facet_samples.push_back(v.point().id());
+			facet_offset.push_back(facet_samples.size());
 			//drawArea->drawPoint(p, 10);
 		}
 
-		// DEBUG:
-		//foreach(std::vector<uint> cell, cells) drawCell(cell);
-
 		// Used later
 		nvertices = this->mesh->n_vertices();
 		nvornoi = loci.size();
+
+		// Transpose into the cell structure (loci of a cell are in increasing order)
+		cell_offset.assign(nvertices+1, 0);
+		for(int k = 0; k < (int)facet_samples.size(); k++)
+			cell_offset[facet_samples[k]+1]++;
+		for(int sidx = 0; sidx < nvertices; sidx++)
+			cell_offset[sidx+1] += cell_offset[sidx];
+		cell_loci.resize(facet_samples.size());
+		std::vector<int> next(cell_offset.begin(), cell_offset.end()-1);
+		for(int vidx = 0; vidx < nvornoi; vidx++)
+			for(int k = facet_offset[vidx]; k < facet_offset[vidx+1]; k++)
+				cell_loci[ next[facet_samples[k]]++ ] = vidx;
+
+		// Surface samples a voronoi loci corresponds to. Assuming general 
+		// positions there are always 4, otherwise the 4 with smallest index
+		scorr.resize(nvornoi);
+		for(int vidx = 0; vidx < nvornoi; vidx++)
+			scorr[vidx] = smallestFour(&facet_samples[facet_offset[vidx]], &facet_samples[0]+facet_offset[vidx+1]);
+
+		// DEBUG:
+		//for(int sidx = 0; sidx < nvertices; sidx++) drawCell(sidx);
+	}
+
+    /// Alternative to computeVoronoiDiagram + searchVoronoiPoles + getMedialSpokeAngleAndRadii.
+    /// Each voronoi vertex is folded into the "best pole so far" of its samples as soon as qhull
+    /// hands it out, so neither the loci nor the cells are ever stored. Afterwards loci holds one
+    /// pole per sample (poleof is the identity) and setToMedial can be used as usual.
+    void streamVoronoiPoles()
+    {
+		beginPoles();
+        Qhull qhull("", 3, nvertices, &points.data()->x(), "v Qbb");
+		foldPoles(qhull, NULL, NULL, 0);
+		endPoles();
+	}
+
+    /// Streaming poles computed one (overlapping) tile of the bounding box at a time, for meshes
+    /// whose delaunay triangulation does not fit in memory at once. A sample takes the poles of the
+    /// diagram of the tile it lies in, computed together with the samples within overlap of the
+    /// tile: poles are exact when the delaunay neighbors of the sample are all in there.
+    /// Tiles are processed one after the other, the (old) qhull C++ interface is not reentrant.
+    /// A tile size which is not positive, or not smaller than the bounding box, gives a single
+    /// tile; a too small one is enlarged so that there are at most MAX_TILES tiles.
+    void tiledVoronoiPoles(Scalar tilesize, Scalar overlap)
+    {
+		beginPoles();
+
+		// Tiles grid
+		Vector3 bmin = mesh->bbox().minimum();
+		Vector3 bsize = mesh->bbox().diagonal();
+		Scalar extent = std::max(bsize[0], std::max(bsize[1], bsize[2]));
+		if(!(tilesize > 0) || tilesize >= extent)
+			tilesize = (extent > 0) ? extent : Scalar(1);
+		for(;;){
+			double count = 1;
+			for(int i = 0; i < 3; i++)
+				count *= std::max(1.0, std::ceil(bsize[i]/tilesize));
+			if(count <= MAX_TILES) break;
+			tilesize *= 1.25;
+		}
+		if(!(overlap > 0)) overlap = 0;
+		int ntiles[3];
+		for(int i = 0; i < 3; i++)
+			ntiles[i] = std::max(1, (int) std::ceil(bsize[i]/tilesize));
+
+		// Tile of each sample (the last tile along each axis takes the bbox boundary)
+		std::vector<int> tileof(nvertices);
+		for(int sidx = 0; sidx < nvertices; sidx++){
+			Vector3 p = points[Vertex(sidx)];
+			int t[3];
+			for(int i = 0; i < 3; i++)
+				t[i] = std::min(ntiles[i]-1, std::max(0, (int) std::floor((p[i]-bmin[i])/tilesize)));
+			tileof[sidx] = (t[2]*ntiles[1] + t[1])*ntiles[0] + t[0];
+		}
+
+		// Samples bucketed by tile (CSR)
+		int ntotal = ntiles[0]*ntiles[1]*ntiles[2];
+		std::vector<int> tile_offset(ntotal+1, 0);
+		for(int sidx = 0; sidx < nvertices; sidx++) tile_offset[tileof[sidx]+1]++;
+		for(int tile = 0; tile < ntotal; tile++) tile_offset[tile+1] += tile_offset[tile];
+		std::vector<int> tile_samples(nvertices);
+		std::vector<int> next(tile_offset.begin(), tile_offset.end()-1);
+		for(int sidx = 0; sidx < nvertices; sidx++) tile_samples[ next[tileof[sidx]]++ ] = sidx;
+
+		// Neighboring tiles that can contain samples within overlap
+		int reach = (int) std::ceil(std::min(overlap/tilesize, (Scalar) MAX_TILES));
+
+		std::vector<double> coords;
+		std::vector<int> globalid;
+		int nskipped = 0;
+		for(int tz = 0; tz < ntiles[2]; tz++)
+		for(int ty = 0; ty < ntiles[1]; ty++)
+		for(int tx = 0; tx < ntiles[0]; tx++)
+		{
+			int tile = (tz*ntiles[1] + ty)*ntiles[0] + tx;
+			if(tile_offset[tile] == tile_offset[tile+1]) continue;
+			Vector3 lo = bmin + Vector3(tx,ty,tz)*tilesize - Vector3(overlap,overlap,overlap);
+			Vector3 hi = bmin + Vector3(tx+1,ty+1,tz+1)*tilesize + Vector3(overlap,overlap,overlap);
+
+			// Gather the samples of the enlarged tile
+			coords.clear();
+			globalid.clear();
+			for(int nz = std::max(0,tz-reach); nz <= std::min(ntiles[2]-1,tz+reach); nz++)
+			for(int ny = std::max(0,ty-reach); ny <= std::min(ntiles[1]-1,ty+reach); ny++)
+			for(int nx = std::max(0,tx-reach); nx <= std::min(ntiles[0]-1,tx+reach); nx++)
+			{
+				int ntile = (nz*ntiles[1] + ny)*ntiles[0] + nx;
+				for(int k = tile_offset[ntile]; k < tile_offset[ntile+1]; k++){
+					int sidx = tile_samples[k];
+					Vector3 p = points[Vertex(sidx)];
+					if(ntile != tile && (p[0]<lo[0] || p[1]<lo[1] || p[2]<lo[2] || p[0]>hi[0] || p[1]>hi[1] || p[2]>hi[2]))
+						continue;
+					coords.push_back(p[0]); coords.push_back(p[1]); coords.push_back(p[2]);
+					globalid.push_back(sidx);
+				}
+			}
+
+			// Not enough samples for a 3D diagram, these fall back to the first loci
+			int ninterior = tile_offset[tile+1] - tile_offset[tile];
+			if(globalid.size() < 5){ nskipped += ninterior; continue; }
+
+			// Degenerate (e.g. flat) tiles are skipped rather than failing the whole run
+			try{
+				Qhull qhull("", 3, globalid.size(), &coords[0], "v Qbb");
+				foldPoles(qhull, &globalid[0], &tileof[0], tile);
+			} catch(const QhullError&){
+				nskipped += ninterior;
+			}
+		}
+		if(nskipped > 0)
+			qDebug() << "[VOROMAT] tiles too sparse/degenerate for a diagram," << nskipped << "samples without poles";
+
+		endPoles();
+	}
+
+    /// Same as streamVoronoiPoles, with the native delaunay engine (Delaunay3.h) in place of qhull.
+    /// Falls back to qhull when the native tetrahedralization is numerically broken, or leaves some
+    /// (convex hull) samples without a finite tetrahedron.
+    void nativeVoronoiPoles()
+    {
+		beginPoles();
+		Delaunay3 dt(&points.data()->x(), nvertices);
+		if(dt.nBroken() > 0 || dt.nOrphans() > 0){
+			qDebug() << "[VOROMAT] native delaunay broken (" << dt.nBroken() << "unpaired faces,"
+			         << dt.nOrphans() << "samples without tetrahedra), falling back to qhull";
+			streamVoronoiPoles();
+			return;
+		}
+		Vector3 lo = mesh->bbox().minimum();
+		Vector3 hi = mesh->bbox().maximum();
+		std::vector<int> poletet;
+		int first = dt.poles(&vnormal.data()->x(), lo.data(), hi.data(), poletet);
+
+		// Spoke statistics of the poles (samples are the 4 vertices of the tetrahedron)
+        #pragma omp parallel for
+		for(int sidx = 0; sidx < nvertices; sidx++)
+		{
+			int t = poletet[sidx];
+			if(t < 0) continue;
+			loci[sidx] = Vector3(dt.center[3*t], dt.center[3*t+1], dt.center[3*t+2]);
+			max_neg_t[sidx] = dot(Vector3(loci[sidx] - points[Vertex(sidx)]), vnormal[Vertex(sidx)]);
+			spokeAngleAndRadius(loci[sidx], tetCorrespondences(dt, t), alpha[sidx], radii[sidx]);
+		}
+
+		if(first >= 0){
+			hasfirst = true;
+			first_p = Vector3(dt.center[3*first], dt.center[3*first+1], dt.center[3*first+2]);
+			spokeAngleAndRadius(first_p, tetCorrespondences(dt, first), first_alpha, first_radius);
+		}
+		endPoles();
 	}
 
+    /// Bytes used by the voronoi cells & correspondences (only filled by computeVoronoiDiagram)
+    size_t memoryUsage()
+    {
+        return cell_offset.capacity()*sizeof(int) + cell_loci.capacity()*sizeof(int) + scorr.capacity()*sizeof(std::array<int,4>);
+    }
+
+    /// Estimate of what the same data took as nested std::vector (one heap block per cell and
+    /// per loci, counting 16 bytes of allocator overhead for each and no growth slack)
+    size_t nestedMemoryEstimate()
+    {
+        const size_t overhead = 16;
+        size_t cells = nvertices*sizeof(std::vector<uint>) + cell_loci.size()*sizeof(uint) + nvertices*overhead;
+        size_t corrs = nvornoi*(sizeof(std::vector<int>) + 4*sizeof(int) + overhead);
+        return cells + corrs;
+    }
+
 private:
 
-	void drawCell(std::vector<uint> cell)
+	/// @{ streaming state: projection of the best pole on the normal, and the first loci
+	std::vector<double> max_neg_t;
+	bool hasfirst;
+	Vector3 first_p;
+	double first_alpha, first_radius;
+	/// @}
+
+	void beginPoles()
 	{
-		foreach(uint loci_id, cell) drawArea->drawPoint(loci[loci_id], 5);
+		mesh->garbage_collection();
+		mesh->setProperty("handlesVersion", mesh->property("handlesVersion").toInt()+1);
+		nvertices = this->mesh->n_vertices();
+
+		max_neg_t.assign(nvertices, DBL_MAX);
+		loci.assign(nvertices, Vector3(0,0,0));
+		alpha.assign(nvertices, 0);
+		radii.assign(nvertices, 0);
+		poleof.resize(nvertices);
+		for(int sidx = 0; sidx < nvertices; sidx++) poleof[sidx] = sidx;
+
+		hasfirst = false;
+		first_p = Vector3(0,0,0);
+		first_alpha = first_radius = 0;
+	}
+
+	/// Folds the voronoi vertices of qhull into the poles. Qhull point ids are mapped to samples by
+	/// globalid (identity if NULL); if tileof is given, only the samples of the tile are updated.
+	void foldPoles(Qhull& qhull, const int* globalid, const int* tileof, int tile)
+	{
+		std::vector<int> samples;
+		foreach(QhullFacet f, qhull.facetList())
+		{
+			if(f.isUpperDelaunay()) continue;
+
+			QhullPoint qhpnt = f.voronoiVertex(qhull.runId());
+			Vector3 p(qhpnt[0], qhpnt[1], qhpnt[2]);
+
+            if(!mesh->bbox().contains(p)) continue;
+
+			samples.clear();
+			foreach(QhullVertex v, f.vertices())
+				samples.push_back(globalid ? globalid[v.point().id()] : v.point().id());
+
+			// Spoke statistics only computed if the loci is retained by someone
+			bool computed = false;
+			double curralpha = 0, currradius = 0;
+			if(!hasfirst){
+				spokeAngleAndRadius(p, smallestFour(&samples[0], &samples[0]+samples.size()), curralpha, currradius);
+				computed = hasfirst = true;
+				first_p = p; first_alpha = curralpha; first_radius = currradius;
+			}
+
+			for(int k = 0; k < (int)samples.size(); k++)
+			{
+				int sidx = samples[k];
+				if(tileof && tileof[sidx] != tile) continue;
+				double t = dot(Vector3(p - points[Vertex(sidx)]), vnormal[Vertex(sidx)]);
+				if(!(t < 0 && t < max_neg_t[sidx])) continue;
+				if(!computed){
+					spokeAngleAndRadius(p, smallestFour(&samples[0], &samples[0]+samples.size()), curralpha, currradius);
+					computed = true;
+				}
+				max_neg_t[sidx] = t;
+				loci[sidx] = p;
+				alpha[sidx] = curralpha;
+				radii[sidx] = currradius;
+			}
+		}
+	}
+
+	/// Vertices of a tetrahedron, sorted (as smallestFour)
+	static std::array<int,4> tetCorrespondences(const Delaunay3& dt, int t)
+	{
+		std::array<int,4> corr = {{ dt.tetra[4*t], dt.tetra[4*t+1], dt.tetra[4*t+2], dt.tetra[4*t+3] }};
+		std::sort(corr.begin(), corr.end());
+		return corr;
+	}
+
+	/// Samples without any pole refer to the first loci (as in searchVoronoiPoles)
+	void endPoles()
+	{
+		for(int sidx = 0; sidx < nvertices; sidx++){
+			if(max_neg_t[sidx] != DBL_MAX) continue;
+			loci[sidx] = first_p;
+			alpha[sidx] = first_alpha;
+			radii[sidx] = first_radius;
+		}
+		nvornoi = nvertices;
+		std::vector<double>().swap(max_neg_t);
+	}
+
+	void drawCell(int sidx)
+	{
+		for(int k = cell_offset[sidx]; k < cell_offset[sidx+1]; k++) drawArea->drawPoint(loci[cell_loci[k]], 5);
+	}
+
+	/// The 4 smallest sample indices in [begin,end), sorted (0 pads facets with fewer samples)
+	static std::array<int,4> smallestFour(const int* begin, const int* end)
+	{
+		std::array<int,4> corr;
+		corr.fill(INT_MAX);
+		for(const int* k = begin; k != end; k++)
+		{
+			// Insertion in the (sorted) 4 smallest
+			if(*k > corr[3]) continue;
+			corr[3] = *k;
+			for(int j = 3; j > 0 && corr[j] < corr[j-1]; j--)
+				std::swap(corr[j], corr[j-1]);
+		}
+		for(int j = 0; j < 4; j++)
+			if(corr[j] == INT_MAX) corr[j] = 0;
+		return corr;
 	}
 
 	struct Spoke{
@@ -113,53 +412,63 @@ private:
 		}
 	};
 
+	/// Largest aperture between the medial spokes of the voronoi vertex p and the length of its
+	/// spokes. General positions => only 4 samples / loci
+	void spokeAngleAndRadius(const Vector3& voro_vertex, const std::array<int,4>& corr, double& alpha_max, double& radius)
+	{
+		Spoke spokes[4];
+		for(int i_sidx = 0; i_sidx < 4; i_sidx++)
+		{
+			// Create spoke
+			Vector3 s = points[Vertex(corr[i_sidx])] - voro_vertex;
+
+			// Spoke length (shouldn't this be same as we are voronoi loci?)
+			radius = s.norm();
+
+			// Normalize spoke
+			s.normalize();
+			spokes[i_sidx] = Spoke(s[0],s[1],s[2]);
+		}
+
+		// Measure largest spoke aperture
+		alpha_max = 0;
+		for(int i=0; i<4; i++){
+			for(int j=0; j < 4; j++){
+				double curralpha = spokes[i].angle(spokes[j]);
+				if( curralpha > alpha_max )
+					alpha_max = curralpha;
+			}
+		}
+	}
+
 public:
 	void searchVoronoiPoles()
 	{
-		Vector3 surf_vertex;
-		Vector3 voro_vertex;
-		Vector3 surf_normal;
-
         poleof = std::vector<int>(nvertices, 0);
-        scorr  = std::vector< std::vector<int> > (nvornoi, std::vector<int>(4, 0));
 
-		//--- Keeps track of how many 
-		//    surface points a voronoi loci has been 
-		//    associated with. Assuming general positions 
-		//    this number should be always 4.
-        std::vector<int> counter(nvornoi, 0);
+		//--- Correspondences (scorr) are extracted with the diagram
 
-		//--- For every voronoi cell
-        for(uint sidx = 0; (int)sidx < nvertices; sidx++)
+		//--- Poles (every voronoi cell independently)
+        #pragma omp parallel for
+        for(int sidx = 0; sidx < nvertices; sidx++)
 		{
 			// Retrieve surface vertex
-			surf_vertex = points[Vertex(sidx)];
-			surf_normal = vnormal[Vertex(sidx)];
+			Vector3 surf_vertex = points[Vertex(sidx)];
+			Vector3 surf_normal = vnormal[Vertex(sidx)];
 
 			// Index and distance to furthest voronoi loci
 			double max_neg_t = DBL_MAX;
             double max_neg_i = 0;
 
 			// For each element of its voronoi cell
-			for(int j = 0; j < (int)cells[sidx].size(); j++)
+			for(int k = cell_offset[sidx]; k < cell_offset[sidx+1]; k++)
 			{
-				int vidx = cells[sidx][j];
-
-				voro_vertex = loci[vidx];
-
-				// Mark the fact that (voronoi) vidx corresponds to (surface) sidx 
-				// (in the next free location and update this location)
-				// the freesub-th correspondent of the voronoi vertex is vidx
-				int freesub = counter[vidx];
-				if( freesub < 4 ){
-					counter[vidx]++;
-					scorr[vidx][freesub] = sidx;
-				}
+				int vidx = cell_loci[k];
+				Vector3 voro_vertex = loci[vidx];
 
 				// Project the loci on the vertex normal & Retain furthest 
                 double t = dot(Vector3(voro_vertex - surf_vertex), surf_normal);
 				if(t < 0 && t < max_neg_t){
-                    //drawArea->drawPoint(voro_vertex);
 					max_neg_t = t;
 					max_neg_i = vidx;
 				}
@@ -173,60 +482,13 @@ public:
 
 	void getMedialSpokeAngleAndRadii()
 	{
-		//--- Temp data
-		Vector3 surf_vertex;
-		Vector3 voro_vertex;    
-		Vector3 s; // temp spoke data
-		double curralpha;
- 
 		alpha = std::vector<double> ( nvornoi );
 		radii = std::vector<double> ( nvornoi );
 
-		//--- For every voronoi vertex
+		//--- For every voronoi vertex (independently)
+        #pragma omp parallel for
 		for(int vidx = 0; vidx < nvornoi; vidx++)
-		{
-			/// Do not use invalid poles
-			//if( ispole.get(vidx) == 0.0 ) continue;
-
-			// Retrieve vertex coordinates
-			voro_vertex = loci[vidx];
-
-			// Create the medial spokes
-			// General positions => only 4 vertices / loci
-            std::vector<Spoke> spokes;
-			for(int i_sidx = 0; i_sidx < 4; i_sidx++)
-			{
-				// Retrieve surface coordinate
-				int sidx = scorr[vidx][i_sidx];
-				surf_vertex = points[Vertex(sidx)];
-
-				// Create spoke
-				s = surf_vertex - voro_vertex;
-
-				// Spoke length (shouldn't this be same as we are voronoi loci?)
-				radii[vidx] = s.norm();
-    
-				// Normalize spoke
-				s.normalize();
-				spokes.push_back( Spoke(s[0],s[1],s[2]) );
-			}
-
-
-			// Measure largest spoke aperture
-			// and store it in output
-			double alpha_max = 0;
-			for(int i=0; i<4; i++){
-				Spoke& s1 = spokes[i];
-				for(int j=0; j < 4; j++){
-					Spoke& s2 = spokes[j];
-					curralpha = s1.angle(s2);
-					if( curralpha > alpha_max ){
-						alpha_max = curralpha;
-					}
-				}
-			}
-			alpha[vidx] = alpha_max;
-		}
+			spokeAngleAndRadius(loci[vidx], scorr[vidx], alpha[vidx], radii[vidx]);
 	}
 
     void setToMedial(bool isEmbed)
@@ -2,13 +2,29 @@ include($$[STARLAB])
 include($$[SURFACEMESH])
 include($$[QHULL])
 StarlabTemplate(plugin)
+CONFIG += c++11
+
+# OpenMP (pole search, native delaunay engine)
+unix:!macx{
+    QMAKE_CXXFLAGS += -fopenmp
+    QMAKE_LFLAGS += -fopenmp
+}
+win32{
+    QMAKE_CXXFLAGS += /openmp
+}
 
 HEADERS += voromat.h
 
 #---- QHULL VERSION
 HEADERS += QhullVoronoiHelper.h
+HEADERS += Delaunay3.h
 SOURCES += voromat_qhull.cpp
 
+# Peak memory report (shared with the mcfskel plugin)
+INCLUDEPATH += $$PWD/../surfacemesh_filter_mcfskel
+HEADERS += ../surfacemesh_filter_mcfskel/Logfile.h
+SOURCES += ../surfacemesh_filter_mcfskel/Logfile.cpp
+
 #---- UNCOMMENT for MATLAB version
 # STARLAB_EXTERNAL += matlab
 # SOURCES += voromat_matlab.cpp
@@ -7,6 +7,15 @@ const QString embedVertices = "embedVertices";
 const QString overlayInput  = "overlayInput";
 const QString colorizeRadii = "colorizeRadii";
 const QString colorizeAngle = "colorizeAngle";
+const QString engine        = "engine";
+const QString streaming     = "streaming";
+const QString tiled         = "tiled";
+const QString tileSize      = "tileSize";
+const QString tileOverlap   = "tileOverlap";
+
+/// Pole engines
+const QString ENGINE_QHULL  = "Qhull";
+const QString ENGINE_NATIVE = "Native (parallel)";
 
 /// Surface property names
 const std::string VRADII = "v:radii";
@@ -34,6 +43,13 @@ public:
         pars->addParam(new RichBool(overlayInput,false,"Overlay input","Should I overlay the input dataset on top of the medial mesh?"));        
         pars->addParam(new RichBool(colorizeRadii,false,"Colorize Medial Radii", "Vertex color is color-mapped to medial radius"));
         pars->addParam(new RichBool(colorizeAngle,false,"Colorize Medial Angle", "Vertex color is color-mapped to medial aperture angle"));
+        pars->addParam(new RichStringSet(engine,QStringList() << ENGINE_QHULL << ENGINE_NATIVE,"Engine", "Qhull, or the native delaunay tetrahedralization (tiled/streaming only apply to qhull)"));
+        pars->addParam(new RichBool(streaming,false,"Streaming", "Fold the voronoi vertices into the poles as they are extracted, without storing the voronoi cells (less memory)"));
+        
+        /// Out-of-core parameters (relative to the bbox diagonal)
+        pars->addParam(new RichBool(tiled,false,"Tiled", "Compute the poles one tile of the bounding box at a time (for meshes too large for a single diagram)"));
+        pars->addParam(new RichFloat(tileSize,0.25f,"Tile size", "Size of the tiles, as a fraction of the bounding box diagonal"));
+        pars->addParam(new RichFloat(tileOverlap,0.05f,"Tile overlap", "Samples within this distance (as a fraction of the bounding box diagonal) of a tile are added to its diagram"));
     }
     
     void applyFilter(RichParameterSet* pars);
@@ -4,6 +4,7 @@
 #include <QElapsedTimer>
 #include "StarlabDrawArea.h"
 #include "QhullVoronoiHelper.h"
+#include "Logfile.h"
 
 void filter::applyFilter(RichParameterSet* pars){
     /// Draw the input vertices if overlay was required
@@ -22,11 +23,28 @@ void filter::applyFilter(RichParameterSet* pars){
     QElapsedTimer timer;
     timer.start();
         VoronoiHelper h(mesh(), drawArea());
-        h.computeVoronoiDiagram();
-        h.searchVoronoiPoles();
-        h.getMedialSpokeAngleAndRadii();
+        bool csr = false; ///< only the qhull diagram path fills the cells and correspondences
+        if(pars->getString(engine)==ENGINE_NATIVE){
+            h.nativeVoronoiPoles();
+        } else if(pars->getBool(tiled)){
+            Scalar diag = mesh()->bbox().diagonal().norm();
+            h.tiledVoronoiPoles(pars->getFloat(tileSize)*diag, pars->getFloat(tileOverlap)*diag);
+        } else if(pars->getBool(streaming)){
+            h.streamVoronoiPoles();
+        } else {
+            csr = true;
+            h.computeVoronoiDiagram();
+            h.searchVoronoiPoles();
+            h.getMedialSpokeAngleAndRadii();
+        }
         h.setToMedial(isEmbed);
-    qDebug() << "[VOROMAT]" << timer.elapsed() << "ms";
+    if(csr)
+        qDebug() << "[VOROMAT]" << timer.elapsed() << "ms"
+                 << "cells+correspondences:" << h.memoryUsage()/1024 << "KB"
+                 << "(nested vectors: ~" << h.nestedMemoryEstimate()/1024 << "KB)";
+    else
+        qDebug() << "[VOROMAT]" << timer.elapsed() << "ms"
+                 << "peak memory:" << peakmemory() << "KB";
             
     /// Colorize one of the exposed properties
     if( pars->getBool(colorizeRadii) || pars->getBool(colorizeAngle) ){